@@ -6,10 +6,12 @@
 #include <sys/socket.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
-static int createNonblocking()
+static int createNonblocking(sa_family_t family)
 {
-    int sockfd = ::socket(AF_INET,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int sockfd = ::socket(family,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if(sockfd < 0)
     {
         LOG_FATAL("%s:%s:%d listen socket create err:%d \n",__FILE__,__FUNCTION__,__LINE__,errno);
@@ -19,12 +21,26 @@ static int createNonblocking()
 
 Acceptor::Acceptor(EventLoop *loop,const InetAddress& listenAddr,bool reuseport)
                 :loop_(loop)
-                ,acceptSocket_(createNonblocking()) // 创建socket
+                ,acceptSocket_(createNonblocking(listenAddr.family())) // 创建socket
                 ,acceptChannel_(loop,acceptSocket_.fd())
                 ,listenning_(false)
+                ,idleFd_(::open("/dev/null",O_RDONLY | O_CLOEXEC))
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    if(listenAddr.family() == AF_UNIX)
+    {
+        //上次运行残留的socket文件会导致bind失败，只删除socket类型的文件
+        struct stat st;
+        std::string path = listenAddr.toIp();
+        if(!path.empty() && ::stat(path.c_str(),&st) == 0 && S_ISSOCK(st.st_mode))
+        {
+            ::unlink(path.c_str());
+        }
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(true);
+    }
     acceptSocket_.bindAddress(listenAddr);  //bind
     //TcpServer::start() Accept.listen 有新用户的连接 要执行一个回调 (connfd -> channel -> subloop)
     //baseLoop => acceptChannel_(listenfd) => 
@@ -35,6 +51,7 @@ Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    ::close(idleFd_);
 }
 
 void Acceptor::listen()
@@ -63,9 +80,20 @@ void Acceptor::handleRead()
     else
     {
         LOG_ERROR("%s:%s:%d accept err:%d \n",__FILE__,__FUNCTION__,__LINE__,errno);  
-        if(errno == EMFILE)
+        if(errno == EMFILE || errno == ENFILE)
         {
             LOG_ERROR("%s:%s:%d sockfd reached limit! \n",__FILE__,__FUNCTION__,__LINE__);
+            //连接留在backlog里的话listenfd一直可读，用预留的fd把它接下来再关掉，对端会看到连接被关闭
+            if(idleFd_ >= 0)
+            {
+                ::close(idleFd_);
+                idleFd_ = ::accept(acceptSocket_.fd(),nullptr,nullptr);
+                if(idleFd_ >= 0)
+                {
+                    ::close(idleFd_);
+                }
+                idleFd_ = ::open("/dev/null",O_RDONLY | O_CLOEXEC);
+            }
         }
     }
 }
\ No newline at end of file
@@ -29,4 +29,5 @@ private:
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
     bool listenning_;
+    int idleFd_; //预留的一个fd，fd用完时腾出来accept再立即关掉，避免LT模式下listenfd一直可读忙等
 };
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "Broadcaster.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+#include <functional>
+
+Broadcaster::Broadcaster(size_t backlogLimit)
+    :backlogLimit_(backlogLimit)
+    ,dropped_(0)
+    ,shardList_(std::make_shared<ShardList>())
+{
+}
+
+Broadcaster::~Broadcaster()
+{
+}
+
+Broadcaster::ShardPtr Broadcaster::shardOf(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ShardPtr& shard = shards_[loop];
+    if(!shard)
+    {
+        shard = std::make_shared<Shard>(loop);
+        std::shared_ptr<ShardList> list = std::make_shared<ShardList>(*shardList_);
+        list->push_back(shard);
+        shardList_ = list;
+    }
+    return shard;
+}
+
+void Broadcaster::subscribe(const std::string& topic,const TcpConnectionPtr& conn,SlowConsumerPolicy policy)
+{
+    ShardPtr shard = shardOf(conn->getLoop());
+    shard->loop->runInLoop(std::bind(&Broadcaster::subscribeInLoop,this,shard,topic,conn,policy));
+}
+
+void Broadcaster::unsubscribe(const std::string& topic,const TcpConnectionPtr& conn)
+{
+    ShardPtr shard = shardOf(conn->getLoop());
+    shard->loop->runInLoop(std::bind(&Broadcaster::unsubscribeInLoop,this,shard,topic,conn));
+}
+
+void Broadcaster::unsubscribeAll(const TcpConnectionPtr& conn)
+{
+    ShardPtr shard = shardOf(conn->getLoop());
+    shard->loop->runInLoop(std::bind(&Broadcaster::unsubscribeAllInLoop,this,shard,conn));
+}
+
+void Broadcaster::publish(const std::string& topic,const SharedPayload& payload)
+{
+    std::shared_ptr<const ShardList> list;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        list = shardList_;
+    }
+    for(const ShardPtr& shard : *list)
+    {
+        if(shard->subscriptions > 0)
+        {
+            shard->loop->runInLoop(std::bind(&Broadcaster::deliverInLoop,this,shard,topic,payload));
+        }
+    }
+}
+
+void Broadcaster::subscribeInLoop(const ShardPtr& shard,const std::string& topic,
+    const TcpConnectionPtr& conn,SlowConsumerPolicy policy)
+{
+    if(!conn->connected())
+    {
+        return;
+    }
+    std::vector<Subscriber>& subscribers = shard->topics[topic];
+    for(Subscriber& subscriber : subscribers)
+    {
+        if(subscriber.conn == conn) //重复订阅只更新策略
+        {
+            subscriber.policy = policy;
+            return;
+        }
+    }
+    Subscriber subscriber;
+    subscriber.conn = conn;
+    subscriber.policy = policy;
+    subscribers.push_back(subscriber);
+    ++shard->subscriptions;
+}
+
+void Broadcaster::unsubscribeInLoop(const ShardPtr& shard,const std::string& topic,const TcpConnectionPtr& conn)
+{
+    auto it = shard->topics.find(topic);
+    if(it == shard->topics.end())
+    {
+        return;
+    }
+    std::vector<Subscriber>& subscribers = it->second;
+    for(size_t i=0;i<subscribers.size();i++)
+    {
+        if(subscribers[i].conn == conn)
+        {
+            removeSubscriber(shard.get(),subscribers,i);
+            break;
+        }
+    }
+    if(subscribers.empty())
+    {
+        shard->topics.erase(it);
+    }
+    auto conflated = shard->conflated.find(conn.get());
+    if(conflated != shard->conflated.end())
+    {
+        conflated->second.pending.erase(topic);
+        if(conflated->second.pending.empty())
+        {
+            shard->conflated.erase(conflated);
+            conn->setOutputDrainedCallback(WriteCompleteCallback());
+        }
+    }
+}
+
+void Broadcaster::unsubscribeAllInLoop(const ShardPtr& shard,const TcpConnectionPtr& conn)
+{
+    for(auto it = shard->topics.begin();it != shard->topics.end();)
+    {
+        std::vector<Subscriber>& subscribers = it->second;
+        for(size_t i=0;i<subscribers.size();i++)
+        {
+            if(subscribers[i].conn == conn)
+            {
+                removeSubscriber(shard.get(),subscribers,i);
+                break;
+            }
+        }
+        if(subscribers.empty())
+        {
+            it = shard->topics.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if(shard->conflated.erase(conn.get()) > 0)
+    {
+        conn->setOutputDrainedCallback(WriteCompleteCallback());
+    }
+}
+
+// 和最后一个交换后删除，订阅者的顺序不保证
+void Broadcaster::removeSubscriber(Shard* shard,std::vector<Subscriber>& subscribers,size_t index)
+{
+    if(index + 1 != subscribers.size())
+    {
+        std::swap(subscribers[index],subscribers.back());
+    }
+    subscribers.pop_back();
+    --shard->subscriptions;
+}
+
+void Broadcaster::deliverInLoop(const ShardPtr& shard,const std::string& topic,const SharedPayload& payload)
+{
+    auto it = shard->topics.find(topic);
+    if(it == shard->topics.end())
+    {
+        return;
+    }
+    std::vector<Subscriber>& subscribers = it->second;
+    const size_t limit = backlogLimit_;
+    for(size_t i=0;i<subscribers.size();)
+    {
+        const Subscriber& subscriber = subscribers[i];
+        if(!subscriber.conn->connected())
+        {
+            shard->conflated.erase(subscriber.conn.get());
+            removeSubscriber(shard.get(),subscribers,i);
+            continue;
+        }
+        switch(subscriber.policy)
+        {
+        case kSlowConsumerDrop:
+            if(subscriber.conn->outputBytes() >= limit)
+            {
+                ++dropped_;
+                break;
+            }
+            subscriber.conn->send(payload);
+            break;
+        case kSlowConsumerConflate:
+            //已经有积压着的消息时也要排在它后面，保证同一个topic不乱序
+            if(subscriber.conn->outputBytes() >= limit || shard->conflated.count(subscriber.conn.get()) > 0)
+            {
+                conflate(shard,topic,subscriber.conn,payload);
+                break;
+            }
+            subscriber.conn->send(payload);
+            break;
+        default:
+            subscriber.conn->send(payload);
+            break;
+        }
+        i++;
+    }
+    if(subscribers.empty())
+    {
+        shard->topics.erase(it);
+    }
+}
+
+void Broadcaster::conflate(const ShardPtr& shard,const std::string& topic,
+    const TcpConnectionPtr& conn,const SharedPayload& payload)
+{
+    auto it = shard->conflated.find(conn.get());
+    if(it == shard->conflated.end())
+    {
+        it = shard->conflated.insert(std::make_pair(conn.get(),Conflated())).first;
+        std::weak_ptr<Shard> weakShard(shard);
+        conn->setOutputDrainedCallback(std::bind(&Broadcaster::flushConflated,weakShard,std::placeholders::_1));
+    }
+    SharedPayload& pending = it->second.pending[topic];
+    if(pending)
+    {
+        ++dropped_; //被新消息覆盖
+    }
+    pending = payload;
+}
+
+// 积压写完了，把每个topic最新的一条发出去
+void Broadcaster::flushConflated(const std::weak_ptr<Shard>& weakShard,const TcpConnectionPtr& conn)
+{
+    ShardPtr shard = weakShard.lock();
+    if(!shard)
+    {
+        conn->setOutputDrainedCallback(WriteCompleteCallback());
+        return;
+    }
+    auto it = shard->conflated.find(conn.get());
+    if(it == shard->conflated.end())
+    {
+        return;
+    }
+    std::map<std::string,SharedPayload> pending;
+    pending.swap(it->second.pending);
+    shard->conflated.erase(it);
+    conn->setOutputDrainedCallback(WriteCompleteCallback());
+    if(!conn->connected())
+    {
+        return;
+    }
+    for(auto& item : pending)
+    {
+        conn->send(item.second);
+    }
+}
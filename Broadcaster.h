@@ -0,0 +1,98 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class EventLoop;
+
+// 订阅者的输出积压超过backlogLimit时怎么处理
+enum SlowConsumerPolicy
+{
+    kSlowConsumerQueue,     //照常排队，积压由连接的高水位回调处理
+    kSlowConsumerDrop,      //丢掉这条消息
+    kSlowConsumerConflate,  //只保留这个topic最新的一条，积压写完之后再发
+};
+
+/*
+按topic的广播(pub/sub扇出)
+
+订阅表按连接所属的EventLoop分片，每个分片只在自己的loop线程里访问，不加锁
+publish一次只往每个有订阅的loop投递一个任务，而不是每个连接一次queueInLoop+wakeup；
+同一个SharedPayload被所有订阅者引用，不按连接拷贝(小消息在积压时仍会拷进outputBuffer_)
+
+conflate策略借用TcpConnection::setOutputDrainedCallback等待积压写完，
+同一个连接不能同时被两个Broadcaster用conflate策略订阅
+断开的连接在下一次投递时清理掉，也可以在连接回调里调用unsubscribeAll尽早释放
+*/
+class Broadcaster : noncopyable
+{
+public:
+    explicit Broadcaster(size_t backlogLimit = 1024 * 1024);
+    ~Broadcaster();
+
+    // 以下接口都可以跨线程调用，订阅表的修改在conn所属的loop里完成
+    void subscribe(const std::string& topic,const TcpConnectionPtr& conn,
+        SlowConsumerPolicy policy = kSlowConsumerQueue);
+    void unsubscribe(const std::string& topic,const TcpConnectionPtr& conn);
+    void unsubscribeAll(const TcpConnectionPtr& conn);
+
+    void publish(const std::string& topic,const SharedPayload& payload);
+    void publish(const std::string& topic,const std::string& message)
+    { publish(topic,std::make_shared<const std::string>(message)); }
+
+    // 订阅者未写出的字节数达到limit时按它的SlowConsumerPolicy处理
+    void setBacklogLimit(size_t limit) { backlogLimit_ = limit; }
+
+    // 因为积压被丢弃或者被新消息覆盖的消息条数
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    struct Subscriber
+    {
+        TcpConnectionPtr conn;
+        SlowConsumerPolicy policy;
+    };
+    // conflate策略下积压着的连接，topic => 最新的一条
+    struct Conflated
+    {
+        std::map<std::string,SharedPayload> pending;
+    };
+    struct Shard
+    {
+        explicit Shard(EventLoop* l) : loop(l),subscriptions(0) {}
+
+        EventLoop* loop;
+        std::unordered_map<std::string,std::vector<Subscriber>> topics;
+        std::unordered_map<TcpConnection*,Conflated> conflated;
+        std::atomic<size_t> subscriptions; //publish时跳过没有订阅的分片
+    };
+    using ShardPtr = std::shared_ptr<Shard>;
+    using ShardList = std::vector<ShardPtr>;
+
+    ShardPtr shardOf(EventLoop* loop);
+
+    void subscribeInLoop(const ShardPtr& shard,const std::string& topic,
+        const TcpConnectionPtr& conn,SlowConsumerPolicy policy);
+    void unsubscribeInLoop(const ShardPtr& shard,const std::string& topic,const TcpConnectionPtr& conn);
+    void unsubscribeAllInLoop(const ShardPtr& shard,const TcpConnectionPtr& conn);
+    void deliverInLoop(const ShardPtr& shard,const std::string& topic,const SharedPayload& payload);
+    void conflate(const ShardPtr& shard,const std::string& topic,
+        const TcpConnectionPtr& conn,const SharedPayload& payload);
+    static void flushConflated(const std::weak_ptr<Shard>& weakShard,const TcpConnectionPtr& conn);
+    static void removeSubscriber(Shard* shard,std::vector<Subscriber>& subscribers,size_t index);
+
+    std::atomic<size_t> backlogLimit_;
+    std::atomic<uint64_t> dropped_;
+
+    std::mutex mutex_;  //保护下面两个成员
+    std::map<EventLoop*,ShardPtr> shards_;
+    std::shared_ptr<const ShardList> shardList_; //publish用的快照，增加分片时整体替换
+};
@@ -6,17 +6,18 @@
 
 //从fd上读取数据 poller工作在LT模式
 //Buffer缓冲区是有大小的，但是从fd上读数据时，不知道tcp数据的最终大小
-ssize_t Buffer::readFd(int fd,int* savedErrno)
+ssize_t Buffer::readFd(int fd,int* savedErrno,size_t maxBytes)
 {
-    char extrabuf[65536] = {0}; //栈上内存空间
+    char extrabuf[kExtraBufSize]; //栈上内存空间，readv会直接覆盖，不需要清零
     struct iovec vec[2];    
     const size_t writable = writableBytes();  //这是Buffer底层缓冲区剩余的可写空间大小
+    const size_t limit = readFdLimit(maxBytes);
     vec[0].iov_base = begin()+writerIndex_;
-    vec[0].iov_len = writable;
+    vec[0].iov_len = std::min(writable,limit);
     vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof(extrabuf);    
+    vec[1].iov_len = limit - vec[0].iov_len;
     //判断是在一个缓冲区写完了，还是两个缓冲区都有写
-    const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+    const int iovcnt = (vec[1].iov_len > 0) ? 2 : 1;
     const ssize_t n = ::readv(fd,vec,iovcnt);
 
     if(n <= 0)
@@ -36,9 +37,14 @@ ssize_t Buffer::readFd(int fd,int* savedErrno)
     return n;
 }
 
-ssize_t Buffer::writeFd(int fd,int *savedErrno)
+ssize_t Buffer::writeFd(int fd,int *savedErrno,size_t maxBytes)
 {
-    ssize_t n = ::write(fd,peek(),readableBytes());
+    size_t len = readableBytes();
+    if(maxBytes > 0 && maxBytes < len)
+    {
+        len = maxBytes;
+    }
+    ssize_t n = ::write(fd,peek(),len);
 
     if(n < 0)
     {
@@ -4,6 +4,9 @@
 #include <string>
 #include <algorithm>
 
+#include "MemoryAccountant.h"
+#include "BufferArena.h"
+
 /*
     prependable bytes    |    readable bytes    |   writable bytes
                                 (CONTENTS)
@@ -17,18 +20,87 @@ class Buffer
 public:
     static const size_t kCheapPrepend = 8;
     static const size_t kInitialSize = 1024;
+    static const size_t kExtraBufSize = 65536; //readFd借用的栈上缓冲区大小
 
     explicit Buffer(size_t initialSize = kInitialSize)
         : buffer_(kCheapPrepend + initialSize)
         , readerIndex_(kCheapPrepend)
         , writerIndex_(kCheapPrepend)
-    {}
+        , account_(MemoryAccountant::currentAccount())
+    {
+        MemoryAccountant::charge(account_,buffer_.capacity());
+    }
+
+    ~Buffer()
+    {
+        MemoryAccountant::charge(account_,-static_cast<int64_t>(buffer_.capacity()));
+    }
+
+    Buffer(const Buffer& other)
+        : buffer_(other.buffer_)
+        , readerIndex_(other.readerIndex_)
+        , writerIndex_(other.writerIndex_)
+        , account_(other.account_)
+    {
+        MemoryAccountant::charge(account_,buffer_.capacity());
+    }
+
+    // 存储连同它的记账一起转移，被移走的Buffer容量为0，仍然可以继续append
+    Buffer(Buffer&& other) noexcept
+        : buffer_(std::move(other.buffer_))
+        , readerIndex_(other.readerIndex_)
+        , writerIndex_(other.writerIndex_)
+        , account_(other.account_)
+    {
+        other.readerIndex_ = kCheapPrepend;
+        other.writerIndex_ = kCheapPrepend;
+    }
+
+    Buffer& operator=(const Buffer& other)
+    {
+        if(this != &other)
+        {
+            Buffer tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    Buffer& operator=(Buffer&& other) noexcept
+    {
+        if(this != &other)
+        {
+            MemoryAccountant::charge(account_,-static_cast<int64_t>(buffer_.capacity()));
+            buffer_ = std::move(other.buffer_);
+            readerIndex_ = other.readerIndex_;
+            writerIndex_ = other.writerIndex_;
+            account_ = other.account_;
+            other.buffer_.clear();
+            other.buffer_.shrink_to_fit();
+            other.readerIndex_ = kCheapPrepend;
+            other.writerIndex_ = kCheapPrepend;
+        }
+        return *this;
+    }
+
+    // 把这个Buffer的用量改记到account上，比如连接的Buffer记到所属loop的账户
+    void setAccount(MemoryAccount* account)
+    {
+        if(account != account_)
+        {
+            int64_t bytes = static_cast<int64_t>(buffer_.capacity());
+            MemoryAccountant::charge(account_,-bytes);
+            MemoryAccountant::charge(account,bytes);
+            account_ = account;
+        }
+    }
 
     size_t readableBytes() const
     { return writerIndex_ - readerIndex_; }
 
+    //被移走的Buffer存储为空，writerIndex_仍是kCheapPrepend，下一次append时makeSpace重新分配
     size_t writableBytes() const
-    { return buffer_.size() - writerIndex_; }
+    { return buffer_.size() > writerIndex_ ? buffer_.size() - writerIndex_ : 0; }
 
     size_t prependableBytes() const
     { return readerIndex_; }
@@ -85,7 +157,12 @@ public:
     {
         if(writableBytes() + prependableBytes() < len + kCheapPrepend)
         {
+            size_t oldCapacity = buffer_.capacity();
             buffer_.resize(writerIndex_+len);
+            if(buffer_.capacity() != oldCapacity)
+            {
+                MemoryAccountant::charge(account_,static_cast<int64_t>(buffer_.capacity()) - static_cast<int64_t>(oldCapacity));
+            }
         }
         else
         {
@@ -112,18 +189,30 @@ public:
         writerIndex_ += len;
     }
 
-    //从fd上读取数据
-    ssize_t readFd(int fd,int* savedErrno);
-    //通过fd发送数据
-    ssize_t writeFd(int fd,int *saveErrno);
+    size_t internalCapacity() const
+    { return buffer_.capacity(); }
+
+    //一次readFd(fd,savedErrno,maxBytes)最多会读取的字节数，返回值等于它说明fd上可能还有数据
+    size_t readFdLimit(size_t maxBytes = 0) const
+    {
+        const size_t writable = writableBytes();
+        //Buffer剩余空间不足64K时才借用栈上的extrabuf
+        size_t limit = writable < kExtraBufSize ? writable + kExtraBufSize : writable;
+        return (maxBytes > 0 && maxBytes < limit) ? maxBytes : limit;
+    }
+
+    //从fd上读取数据，maxBytes>0时最多读取maxBytes字节
+    ssize_t readFd(int fd,int* savedErrno,size_t maxBytes = 0);
+    //通过fd发送数据，maxBytes>0时最多发送maxBytes字节
+    ssize_t writeFd(int fd,int *saveErrno,size_t maxBytes = 0);
 
 private:
 
     char* begin()
-    { return &*buffer_.begin(); } //vector底层数组首元素的地址，也就是数组的起始地址
+    { return buffer_.data(); } //vector底层数组首元素的地址，也就是数组的起始地址；存储为空时不解引用
 
     const char* begin() const
-    { return &*buffer_.begin(); }
+    { return buffer_.data(); }
 
     char* beginWrite()
     { return begin() + writerIndex_; }
@@ -131,7 +220,8 @@ private:
     const char* beginWrite() const
     { return begin() + writerIndex_; }
 
-    std::vector<char> buffer_;
+    std::vector<char,BufferAllocator<char>> buffer_; //大块存储来自BufferArena，见BufferAllocator
     size_t readerIndex_;
     size_t writerIndex_;
+    MemoryAccount* account_; //buffer_的容量记在这个账户上
 };
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "BufferArena.h"
+#include "Logger.h"
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <errno.h>
+#include <sys/mman.h>
+
+#ifndef MADV_FREE
+#define MADV_FREE 8
+#endif
+
+std::atomic<size_t> BufferArena::threshold_(0);
+std::atomic<bool> BufferArena::useHugeTlb_(false);
+std::atomic<size_t> BufferArena::maxCachedBytes_(BufferArena::kDefaultMaxCachedBytes);
+
+namespace
+{
+struct Segment
+{
+    size_t size;
+    bool hugeTlb;
+};
+
+std::mutex g_mutex;
+std::unordered_map<void*,Segment> g_live;       //在用的段
+std::multimap<size_t,std::pair<void*,bool>> g_free; //缓存的段，大小 => (地址,是否MAP_HUGETLB)
+size_t g_mappedBytes = 0;
+size_t g_cachedBytes = 0;
+size_t g_hugeTlbSegments = 0;
+
+size_t roundUp(size_t bytes)
+{
+    return (bytes + BufferArena::kSegmentAlign - 1) / BufferArena::kSegmentAlign * BufferArena::kSegmentAlign;
+}
+
+// 多映射一个对齐单位，再把头尾裁掉，得到2MB对齐的段，透明大页才能整页映射
+void* mapAligned(size_t size)
+{
+    size_t len = size + BufferArena::kSegmentAlign;
+    void* p = ::mmap(nullptr,len,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+    if(p == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(p);
+    uintptr_t aligned = (start + BufferArena::kSegmentAlign - 1) & ~(BufferArena::kSegmentAlign - 1);
+    if(aligned > start)
+    {
+        ::munmap(p,aligned - start);
+    }
+    size_t tail = start + len - (aligned + size);
+    if(tail > 0)
+    {
+        ::munmap(reinterpret_cast<void*>(aligned + size),tail);
+    }
+    ::madvise(reinterpret_cast<void*>(aligned),size,MADV_HUGEPAGE);
+    return reinterpret_cast<void*>(aligned);
+}
+}
+
+void BufferArena::setThreshold(size_t bytes)
+{
+    threshold_ = (bytes > 0 && bytes < kMinThreshold) ? kMinThreshold : bytes;
+}
+
+void* BufferArena::allocate(size_t bytes)
+{
+    const size_t size = roundUp(bytes);
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto it = g_free.find(size);
+        if(it != g_free.end())
+        {
+            void* p = it->second.first;
+            Segment segment = { size,it->second.second };
+            g_free.erase(it);
+            g_cachedBytes -= size;
+            g_live[p] = segment;
+            return p;
+        }
+    }
+
+    Segment segment = { size,false };
+    void* p = nullptr;
+    if(useHugeTlb_)
+    {
+        p = ::mmap(nullptr,size,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,-1,0);
+        if(p == MAP_FAILED)
+        {
+            p = nullptr; //没有预留大页，退回透明大页
+        }
+        else
+        {
+            segment.hugeTlb = true;
+        }
+    }
+    if(p == nullptr)
+    {
+        p = mapAligned(size);
+    }
+    if(p == nullptr)
+    {
+        LOG_ERROR("BufferArena::allocate mmap %zu bytes failed errno:%d \n",size,errno);
+        throw std::bad_alloc();
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_live[p] = segment;
+    g_mappedBytes += size;
+    if(segment.hugeTlb)
+    {
+        ++g_hugeTlbSegments;
+    }
+    return p;
+}
+
+bool BufferArena::deallocate(void* p)
+{
+    //arena的段都是kSegmentAlign对齐的，malloc来的大块基本不会对齐，不用去查g_live
+    if(reinterpret_cast<uintptr_t>(p) & (kSegmentAlign - 1))
+    {
+        return false;
+    }
+    Segment segment;
+    bool cache;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto it = g_live.find(p);
+        if(it == g_live.end())
+        {
+            return false;
+        }
+        segment = it->second;
+        g_live.erase(it);
+        cache = g_cachedBytes + segment.size <= maxCachedBytes_;
+        if(cache)
+        {
+            g_cachedBytes += segment.size; //先占上缓存额度，段在下面madvise之后才放进g_free
+        }
+        else
+        {
+            g_mappedBytes -= segment.size;
+            if(segment.hugeTlb)
+            {
+                --g_hugeTlbSegments;
+            }
+        }
+    }
+
+    if(!cache)
+    {
+        ::munmap(p,segment.size);
+        return true;
+    }
+    //物理页还给内核，地址空间留着复用；MAP_HUGETLB的页是预留的，不用还
+    if(!segment.hugeTlb && ::madvise(p,segment.size,MADV_FREE) != 0)
+    {
+        ::madvise(p,segment.size,MADV_DONTNEED);
+    }
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_free.insert(std::make_pair(segment.size,std::make_pair(p,segment.hugeTlb)));
+    return true;
+}
+
+size_t BufferArena::mappedBytes()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_mappedBytes;
+}
+
+size_t BufferArena::cachedBytes()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_cachedBytes;
+}
+
+size_t BufferArena::hugeTlbSegments()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_hugeTlbSegments;
+}
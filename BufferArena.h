@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <new>
+#include <utility>
+
+/*
+Buffer大块存储的分配策略
+
+大流量的连接会把Buffer扩到几MB，走malloc时每次扩容都是新的大块内存: 逐页缺页、4K页的TLB压力大，
+释放后还给malloc的内存也是零碎的
+不小于threshold的存储改由BufferArena直接mmap，按2MB对齐、2MB取整:
+    setUseHugeTlb(true)时先尝试MAP_HUGETLB(需要预留大页)，失败或者关闭时用普通映射加MADV_HUGEPAGE交给透明大页
+释放的段用MADV_FREE(不支持时MADV_DONTNEED)把物理页还给内核，地址空间缓存起来给同样大小的下一次分配复用，
+缓存超过maxCachedBytes的段直接munmap
+
+所有接口线程安全，大块分配很少，用一把锁
+默认关闭，由应用调用setThreshold打开；不是2MB对齐的内存一定不是arena的，释放时不用拿锁
+*/
+class BufferArena
+{
+public:
+    static const size_t kSegmentAlign = 2 * 1024 * 1024;      //大页大小，段按它对齐和取整
+    static const size_t kMinThreshold = 64 * 1024;            //比它小的分配不会进arena
+    static const size_t kSuggestedThreshold = 1024 * 1024;   //打开arena时建议的threshold
+    static const size_t kDefaultMaxCachedBytes = 64 * 1024 * 1024;
+
+    // 分配不小于threshold字节时走arena，0表示关闭(默认)；小于kMinThreshold时按kMinThreshold，随时可以修改
+    static void setThreshold(size_t bytes);
+    static size_t threshold() { return threshold_.load(std::memory_order_relaxed); }
+    static void setUseHugeTlb(bool on) { useHugeTlb_ = on; }
+    static void setMaxCachedBytes(size_t bytes) { maxCachedBytes_ = bytes; }
+
+    static bool useArena(size_t bytes)
+    {
+        size_t limit = threshold();
+        return limit > 0 && bytes >= limit;
+    }
+    static void* allocate(size_t bytes);
+    // p不是arena分配的时返回false
+    static bool deallocate(void* p);
+
+    // 映射着的段(在用的和缓存的)总字节数，缓存的字节数，MAP_HUGETLB成功的段数
+    static size_t mappedBytes();
+    static size_t cachedBytes();
+    static size_t hugeTlbSegments();
+
+private:
+    static std::atomic<size_t> threshold_;
+    static std::atomic<bool> useHugeTlb_;
+    static std::atomic<size_t> maxCachedBytes_;
+};
+
+/*
+Buffer底层vector用的分配器: 大块存储交给BufferArena，其余走operator new
+construct不做值初始化，vector扩容时不用先把新的几MB清零
+*/
+template <typename T>
+class BufferAllocator
+{
+public:
+    using value_type = T;
+
+    BufferAllocator() {}
+    template <typename U>
+    BufferAllocator(const BufferAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        size_t bytes = n * sizeof(T);
+        if(BufferArena::useArena(bytes))
+        {
+            return static_cast<T*>(BufferArena::allocate(bytes));
+        }
+        return static_cast<T*>(::operator new(bytes));
+    }
+
+    void deallocate(T* p,size_t n)
+    {
+        //threshold可能在分配之后改过，大块内存由arena自己判断是不是它的
+        if(n * sizeof(T) >= BufferArena::kMinThreshold && BufferArena::deallocate(p))
+        {
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    template <typename U>
+    void construct(U* p) { ::new(static_cast<void*>(p)) U; }
+    template <typename U,typename... Args>
+    void construct(U* p,Args&&... args) { ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+    template <typename U>
+    bool operator==(const BufferAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const BufferAllocator<U>&) const { return false; }
+};
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 
 class Buffer;
 class TcpConnection;
@@ -17,4 +18,7 @@ using MessageCallback = std::function<void(const TcpConnectionPtr&,
                                     Buffer*,
                                     Timestamp)>;
 
-using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&,size_t)>;
\ No newline at end of file
+using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&,size_t)>;
+
+// 引用计数的只读发送数据，发送过程中不拷贝，最后一个持有者释放时才析构
+using SharedPayload = std::shared_ptr<const std::string>;
\ No newline at end of file
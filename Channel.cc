@@ -15,7 +15,9 @@ Channel::Channel(EventLoop *loop, int fd)
     ,events_(0)
     ,revents_(0)
     ,index_(-1)
+    ,throttled_(false)
     ,tied_(false)
+    ,handler_(nullptr)
     {}
 
 Channel::~Channel()
@@ -47,7 +49,11 @@ void Channel::remove()
 // fd得到poller通知以后，处理事件的
 void Channel::handleEvent(Timestamp receiveTime)
 {
-    if(tied_)
+    if(handler_ != nullptr)
+    {
+        handleEventWithGuard(receiveTime);
+    }
+    else if(tied_)
     {
         std::shared_ptr<void> guard = tie_.lock();
         if(guard)
@@ -65,10 +71,16 @@ void Channel::handleEvent(Timestamp receiveTime)
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
     // LOG_INFO("channel handleEvent revents:%d \n",revents_);
+    throttled_ = false; //回调里用完预算时会重新标记
+
 
     if((revents_ & EPOLLHUP) && (revents_ & EPOLLIN))
     {
-        if(closeCallback_)
+        if(handler_)
+        {
+            handler_->onChannelClose();
+        }
+        else if(closeCallback_)
         {
             closeCallback_();
         }
@@ -76,7 +88,11 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
 
     if(revents_ & EPOLLERR)
     {
-        if(errorCallback_)
+        if(handler_)
+        {
+            handler_->onChannelError();
+        }
+        else if(errorCallback_)
         {
             errorCallback_();
         }
@@ -84,7 +100,11 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
 
     if(revents_ & (EPOLLIN | EPOLLPRI))
     {
-        if(readCallback_)
+        if(handler_)
+        {
+            handler_->onChannelRead(receiveTime);
+        }
+        else if(readCallback_)
         {
             readCallback_(receiveTime);
         }
@@ -92,7 +112,11 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
 
     if(revents_ & EPOLLOUT)
     {
-        if(writeCallback_)
+        if(handler_)
+        {
+            handler_->onChannelWrite();
+        }
+        else if(writeCallback_)
         {
             writeCallback_();
         }
@@ -8,6 +8,24 @@
 
 class EventLoop;
 
+/*
+Channel的另一种分发方式: 事件直接调用handler的虚函数，不经过四个std::function
+handler模式下不做tie检查(每个事件省掉一次weak_ptr::lock的原子加减)，由handler自己保证生命周期:
+在channel从poller里remove之前、以及本轮事件分发结束之前，handler都不能被析构
+TcpConnection满足这个条件: handleClose期间自己持有shared_ptr，connectDestroyed总是queueInLoop之后才执行
+*/
+class ChannelHandler
+{
+public:
+    virtual void onChannelRead(Timestamp receiveTime) = 0;
+    virtual void onChannelWrite() = 0;
+    virtual void onChannelClose() = 0;
+    virtual void onChannelError() = 0;
+
+protected:
+    ~ChannelHandler() = default;
+};
+
 /*
 EventLoop,Channel,Poller之间的关系   <= Reactor模型上对应 Demultiplex
 
@@ -45,6 +63,9 @@ public:
         errorCallback_ = std::move(cb);
     }
 
+    // 设置以后忽略上面的回调和tie，见ChannelHandler
+    void setHandler(ChannelHandler *handler) { handler_ = handler; }
+
     // 防止当channel被手动remove掉，channel还在执行回调操作
     void tie(const std::shared_ptr<void> &);
 
@@ -65,6 +86,10 @@ public:
     bool isWriting() const {return events_ & kWriteEvent; }
     bool isReading() const {return events_ & kReadEvent; }
 
+    // 上一次处理事件时是否用完了本轮的读写预算，EventLoop会把这样的channel排到下一轮的最后
+    bool throttled() const { return throttled_; }
+    void setThrottled(bool on) { throttled_ = on; }
+
     int index() { return index_; }
     void set_index(int idx) { index_ = idx; }
 
@@ -86,9 +111,11 @@ private:
     int events_;      // 注册的fd感兴趣的事件
     int revents_;     // poller返回的具体发生的事件
     int index_;       // channel在poller中的状态
+    bool throttled_;  // 是否用完了读写预算
 
     std::weak_ptr<void> tie_;
     bool tied_;
+    ChannelHandler *handler_;
 
     // 因为channel通道里面能够获取fd最终发生的具体的事件events,所以它负责调用具体事件的回调操作
     ReadEventCallback readCallback_;
@@ -0,0 +1,75 @@
+#include "Clock.h"
+#include "Logger.h"
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define MYMUDUO_HAVE_TSC 1
+#endif
+
+bool Clock::tscEnabled_ = false;
+uint64_t Clock::tscBase_ = 0;
+int64_t Clock::nsBase_ = 0;
+uint64_t Clock::nsPerTick_ = 0;
+
+int64_t Clock::monotonicNs()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC,&ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+#ifdef MYMUDUO_HAVE_TSC
+
+int64_t Clock::tscNowNs()
+{
+    uint64_t ticks = __rdtsc() - tscBase_;
+    return nsBase_ + static_cast<int64_t>((static_cast<unsigned __int128>(ticks) * nsPerTick_) >> 32);
+}
+
+bool Clock::enableTsc()
+{
+    //CPUID.80000007H:EDX[8] invariant TSC
+    unsigned int eax,ebx,ecx,edx;
+    if(__get_cpuid(0x80000000,&eax,&ebx,&ecx,&edx) == 0 || eax < 0x80000007
+        || __get_cpuid(0x80000007,&eax,&ebx,&ecx,&edx) == 0 || (edx & (1u << 8)) == 0)
+    {
+        LOG_INFO("Clock::enableTsc - invariant TSC not available, using clock_gettime \n");
+        return false;
+    }
+
+    //用20ms的CLOCK_MONOTONIC标定TSC频率
+    int64_t ns0 = monotonicNs();
+    uint64_t tsc0 = __rdtsc();
+    struct timespec delay = {0,20 * 1000 * 1000};
+    ::nanosleep(&delay,nullptr);
+    int64_t ns1 = monotonicNs();
+    uint64_t tsc1 = __rdtsc();
+    if(tsc1 <= tsc0 || ns1 <= ns0)
+    {
+        return false;
+    }
+
+    nsPerTick_ = static_cast<uint64_t>((static_cast<unsigned __int128>(ns1 - ns0) << 32) / (tsc1 - tsc0));
+    tscBase_ = tsc1;
+    nsBase_ = ns1;
+    tscEnabled_ = true;
+    LOG_INFO("Clock::enableTsc - %.3f GHz \n",4294967296.0 / static_cast<double>(nsPerTick_));
+    return true;
+}
+
+#else
+
+int64_t Clock::tscNowNs()
+{
+    return monotonicNs();
+}
+
+bool Clock::enableTsc()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+单调时钟，纳秒
+
+默认走clock_gettime(CLOCK_MONOTONIC)，glibc里是vDSO调用，不陷入内核，一次几十纳秒
+enableTsc()之后直接读TSC再换算成纳秒，一次几纳秒；只在CPU报告了invariant TSC
+(频率恒定、各核同步)时才会打开，换算系数启动时用CLOCK_MONOTONIC标定
+
+EventLoop每轮poll返回时读一次，回调里用EventLoop::pollReturnNs()就不用再读时钟
+*/
+class Clock
+{
+public:
+    static int64_t nowNs()
+    {
+        return tscEnabled_ ? tscNowNs() : monotonicNs();
+    }
+
+    // 总是走clock_gettime
+    static int64_t monotonicNs();
+
+    // 尝试打开TSC快速路径，CPU不支持时返回false，继续用clock_gettime；应该在启动线程之前调用
+    static bool enableTsc();
+    static void disableTsc() { tscEnabled_ = false; }
+    static bool tscEnabled() { return tscEnabled_; }
+
+private:
+    static int64_t tscNowNs();
+
+    static bool tscEnabled_;
+    static uint64_t tscBase_;   //标定时的TSC
+    static int64_t nsBase_;     //标定时的单调时钟
+    static uint64_t nsPerTick_; //每个TSC周期多少纳秒，32位定点小数
+};
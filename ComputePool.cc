@@ -0,0 +1,189 @@
+#include "ComputePool.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Thread.h"
+#include "Logger.h"
+
+// 当前线程所属的ComputePool和worker下标，worker里提交的任务放进自己的队列
+static thread_local ComputePool* t_pool = nullptr;
+static thread_local size_t t_workerIndex = 0;
+
+ComputePool::ComputePool(const std::string& name)
+    :name_(name)
+    ,next_(0)
+    ,pending_(0)
+    ,steals_(0)
+    ,running_(false)
+{
+}
+
+ComputePool::~ComputePool()
+{
+    stop();
+}
+
+void ComputePool::start(int numThreads)
+{
+    if(running_ || numThreads <= 0)
+    {
+        return;
+    }
+    running_ = true;
+    for(int i=0;i<numThreads;i++)
+    {
+        workers_.emplace_back(new Worker);
+    }
+    for(int i=0;i<numThreads;i++)
+    {
+        threads_.emplace_back(new Thread(std::bind(&ComputePool::workerLoop,this,static_cast<size_t>(i)),
+            name_ + std::to_string(i)));
+        threads_.back()->start();
+    }
+}
+
+void ComputePool::stop()
+{
+    if(!running_)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_all();
+    for(std::unique_ptr<Thread>& thread : threads_)
+    {
+        thread->join();
+    }
+    threads_.clear();
+    workers_.clear();
+}
+
+void ComputePool::run(Task task)
+{
+    if(workers_.empty())
+    {
+        LOG_ERROR("ComputePool::run [%s] not started, run task in caller thread \n",name_.c_str());
+        task();
+        return;
+    }
+    push(std::move(task));
+}
+
+void ComputePool::submit(EventLoop* loop,Task work,Task done)
+{
+    //bind只在C++14以后才能移动捕获，这里用shared_ptr把两个函数对象带进任务里
+    std::shared_ptr<Task> workPtr = std::make_shared<Task>(std::move(work));
+    std::shared_ptr<Task> donePtr = std::make_shared<Task>(std::move(done));
+    run([loop,workPtr,donePtr]()
+    {
+        (*workPtr)();
+        loop->queueInLoop(std::move(*donePtr));
+    });
+}
+
+void ComputePool::submit(const TcpConnectionPtr& conn,Task work,ConnectionTask done)
+{
+    std::shared_ptr<ConnectionTask> donePtr = std::make_shared<ConnectionTask>(std::move(done));
+    submit(conn->getLoop(),std::move(work),[conn,donePtr]()
+    {
+        (*donePtr)(conn);
+    });
+}
+
+void ComputePool::submit(const StrandPtr& strand,EventLoop* loop,Task work,Task done)
+{
+    //strand上的任务一个接一个执行，done按同样的顺序进入loop的pendingFunctors_
+    std::shared_ptr<Task> workPtr = std::make_shared<Task>(std::move(work));
+    std::shared_ptr<Task> donePtr = std::make_shared<Task>(std::move(done));
+    strand->post([loop,workPtr,donePtr]()
+    {
+        (*workPtr)();
+        loop->queueInLoop(std::move(*donePtr));
+    });
+}
+
+void ComputePool::submitOrdered(const TcpConnectionPtr& conn,Task work,ConnectionTask done)
+{
+    if(!conn->strand())
+    {
+        conn->setStrand(Strand::create(this));
+    }
+    std::shared_ptr<ConnectionTask> donePtr = std::make_shared<ConnectionTask>(std::move(done));
+    submit(conn->strand(),conn->getLoop(),std::move(work),[conn,donePtr]()
+    {
+        (*donePtr)(conn);
+    });
+}
+
+void ComputePool::push(Task task)
+{
+    size_t index = (t_pool == this) ? t_workerIndex : next_++ % workers_.size();
+    {
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    ++pending_;
+    {
+        //先加锁再通知，保证worker不会在检查pending_之后、wait之前错过这次通知
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    cond_.notify_one();
+}
+
+bool ComputePool::popLocal(size_t index,Task* task)
+{
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if(worker.tasks.empty())
+    {
+        return false;
+    }
+    *task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    --pending_;
+    return true;
+}
+
+bool ComputePool::steal(size_t index,Task* task)
+{
+    const size_t n = workers_.size();
+    for(size_t i=1;i<n;i++)
+    {
+        Worker& victim = *workers_[(index + i) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.tasks.empty())
+        {
+            *task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --pending_;
+            ++steals_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ComputePool::workerLoop(size_t index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+    for(;;)
+    {
+        Task task;
+        if(popLocal(index,&task) || steal(index,&task))
+        {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock,[this]() { return pending_ > 0 || !running_; });
+        if(!running_ && pending_ == 0)
+        {
+            break;
+        }
+    }
+    t_pool = nullptr;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Strand.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class EventLoop;
+class Thread;
+
+/*
+和IO线程分开的计算线程池，用来把CPU密集的处理从messageCallback里挪出去，
+避免一个重请求把同一个subloop上的其它连接都堵住
+
+每个worker一个双端队列: worker从自己队列的尾部取(刚提交的任务数据还在cache里)，
+自己的队列空了就从别的worker队列的头部偷；worker里再提交的任务放进自己的队列，
+IO线程提交的任务轮流放进各个worker的队列
+任务完成后用queueInLoop把完成回调送回指定的EventLoop，回调里可以直接操作连接
+*/
+class ComputePool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+    using ConnectionTask = std::function<void(const TcpConnectionPtr&)>;
+
+    explicit ComputePool(const std::string& name = std::string("ComputePool"));
+    ~ComputePool();
+
+    void start(int numThreads);
+    // 等队列里的任务都执行完再退出，不能和run/submit并发调用
+    void stop();
+
+    // 在计算线程里执行task，可以跨线程调用；没有start时直接在调用线程里执行
+    void run(Task task);
+    // work在计算线程里执行，完成后done在loop线程里执行
+    void submit(EventLoop* loop,Task work,Task done);
+    // done在conn所属的loop里执行，连接在这期间被持有；连接可能已经断开，done里自己判断connected()
+    void submit(const TcpConnectionPtr& conn,Task work,ConnectionTask done);
+
+    // 同上，但work在strand上串行执行，done按提交的顺序在loop里执行
+    void submit(const StrandPtr& strand,EventLoop* loop,Task work,Task done);
+    // 按连接保序: 用conn->strand()(没有时创建一个绑定到本池的Strand)，同一个连接的work不并发，
+    // done按提交顺序回到连接的loop里，响应不会乱序；在conn所属的loop线程里调用(比如messageCallback里)
+    void submitOrdered(const TcpConnectionPtr& conn,Task work,ConnectionTask done);
+
+    size_t numThreads() const { return workers_.size(); }
+    // 被别的worker偷走执行的任务数
+    uint64_t steals() const { return steals_; }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void push(Task task);
+    bool popLocal(size_t index,Task* task);
+    bool steal(size_t index,Task* task);
+    void workerLoop(size_t index);
+
+    std::string name_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::unique_ptr<Thread>> threads_;
+    std::atomic<size_t> next_;     //IO线程提交时轮流选择的worker
+    std::atomic<size_t> pending_;  //所有队列里的任务数
+    std::atomic<uint64_t> steals_;
+    std::atomic_bool running_;
+
+    std::mutex mutex_;  //只用来配合cond_让空闲的worker睡眠
+    std::condition_variable cond_;
+};
@@ -0,0 +1,167 @@
+#include "ConnectionPool.h"
+#include "TcpConnection.h"
+
+ConnectionPool::ConnectionPool()
+    :ownerTid_(CurrentThread::tid())
+    ,blockSize_(0)
+    ,maxCached_(kDefaultMaxCached)
+    ,remoteCount_(0)
+{
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    for(void* p : freeBlocks_)
+    {
+        ::operator delete(p);
+    }
+    for(void* p : remoteBlocks_)
+    {
+        ::operator delete(p);
+    }
+}
+
+TcpConnectionPtr ConnectionPool::create(EventLoop* loop,
+    uint64_t id,
+    const std::shared_ptr<const std::string>& namePrefix,
+    int sockfd,
+    const InetAddress& localAddr,
+    const InetAddress& peerAddr)
+{
+    ConnectionPoolPtr self(shared_from_this());
+    return std::allocate_shared<TcpConnection>(
+        PoolAllocator<TcpConnection>(self),loop,id,namePrefix,sockfd,localAddr,peerAddr,self);
+}
+
+void ConnectionPool::setMaxCached(size_t n)
+{
+    maxCached_ = n;
+    while(freeBlocks_.size() > n)
+    {
+        ::operator delete(freeBlocks_.back());
+        freeBlocks_.pop_back();
+    }
+    if(freeBuffers_.size() > n * 2)
+    {
+        freeBuffers_.resize(n * 2);
+    }
+}
+
+void ConnectionPool::drainRemote()
+{
+    std::vector<void*> blocks;
+    std::vector<Buffer> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocks.swap(remoteBlocks_);
+        buffers.swap(remoteBuffers_);
+        remoteCount_ = 0;
+    }
+    for(void* p : blocks)
+    {
+        if(freeBlocks_.size() < maxCached_)
+        {
+            freeBlocks_.push_back(p);
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+    for(Buffer& buf : buffers)
+    {
+        if(freeBuffers_.size() < maxCached_ * 2)
+        {
+            freeBuffers_.push_back(std::move(buf));
+        }
+    }
+}
+
+void* ConnectionPool::allocate(size_t size)
+{
+    size_t expected = 0;
+    blockSize_.compare_exchange_strong(expected,size);
+    if(size == blockSize_ && inOwnerThread())
+    {
+        if(freeBlocks_.empty() && remoteCount_.load(std::memory_order_relaxed) > 0)
+        {
+            drainRemote();
+        }
+        if(!freeBlocks_.empty())
+        {
+            void* p = freeBlocks_.back();
+            freeBlocks_.pop_back();
+            return p;
+        }
+    }
+    return ::operator new(size);
+}
+
+void ConnectionPool::deallocate(void* p,size_t size)
+{
+    if(size == blockSize_)
+    {
+        if(inOwnerThread())
+        {
+            if(freeBlocks_.size() < maxCached_)
+            {
+                freeBlocks_.push_back(p);
+                return;
+            }
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(remoteBlocks_.size() < maxCached_)
+            {
+                remoteBlocks_.push_back(p);
+                ++remoteCount_;
+                return;
+            }
+        }
+    }
+    ::operator delete(p);
+}
+
+Buffer ConnectionPool::takeBuffer()
+{
+    if(inOwnerThread())
+    {
+        if(freeBuffers_.empty() && remoteCount_.load(std::memory_order_relaxed) > 0)
+        {
+            drainRemote();
+        }
+        if(!freeBuffers_.empty())
+        {
+            Buffer buf(std::move(freeBuffers_.back()));
+            freeBuffers_.pop_back();
+            return buf;
+        }
+    }
+    return Buffer();
+}
+
+void ConnectionPool::giveBuffer(Buffer* buf)
+{
+    if(buf->internalCapacity() > kMaxRecycledBufferSize)
+    {
+        return;
+    }
+    buf->retrieveAll();
+    if(inOwnerThread())
+    {
+        if(freeBuffers_.size() < maxCached_ * 2)
+        {
+            freeBuffers_.push_back(std::move(*buf));
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(remoteBuffers_.size() < maxCached_ * 2)
+        {
+            remoteBuffers_.push_back(std::move(*buf));
+            ++remoteCount_;
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Buffer.h"
+#include "CurrentThread.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <new>
+
+class EventLoop;
+class InetAddress;
+
+/*
+每个EventLoop一个的TcpConnection对象池
+
+TcpConnection用std::allocate_shared创建: 连接对象(内含Socket、Channel)和shared_ptr的引用计数
+在同一块内存里，只分配一次；连接销毁后这块内存回到池里，下一个连接直接复用
+连接的inputBuffer_/outputBuffer_在析构时也交还给池，新连接拿走它们已经扩过容的存储
+
+创建池的线程(也就是EventLoop的线程)是它的owner，owner线程上的分配和释放只碰本地空闲链表，不加锁
+连接可能在别的线程上释放最后一个引用，这些内存先放进加锁的remote链表，owner本地用完时一次性收回来
+别的线程上的分配直接走operator new
+池本身由shared_ptr管理，分配器里也持有一份，EventLoop先析构时池会活到最后一个连接释放
+*/
+class ConnectionPool : noncopyable, public std::enable_shared_from_this<ConnectionPool>
+{
+public:
+    static const size_t kDefaultMaxCached = 1024;
+    static const size_t kMaxRecycledBufferSize = 64 * 1024; //更大的Buffer直接释放，不长期占着内存
+
+    ConnectionPool();
+    ~ConnectionPool();
+
+    TcpConnectionPtr create(EventLoop* loop,
+        uint64_t id,
+        const std::shared_ptr<const std::string>& namePrefix,
+        int sockfd,
+        const InetAddress& localAddr,
+        const InetAddress& peerAddr);
+
+    // 最多缓存多少个空闲的连接内存块(Buffer是它的两倍)，0表示不缓存；在owner线程里调用
+    void setMaxCached(size_t n);
+
+    // owner线程本地空闲的内存块和Buffer个数
+    size_t cachedBlocks() const { return freeBlocks_.size(); }
+    size_t cachedBuffers() const { return freeBuffers_.size(); }
+
+    void* allocate(size_t size);
+    void deallocate(void* p,size_t size);
+
+    // 取一个缓存的Buffer，没有缓存时新建一个
+    Buffer takeBuffer();
+    // buf的存储交还给池，之后buf不能再用
+    void giveBuffer(Buffer* buf);
+
+private:
+    bool inOwnerThread() const { return CurrentThread::tid() == ownerTid_; }
+    // owner线程: 把别的线程释放的内存块和Buffer收到本地链表
+    void drainRemote();
+
+    const int ownerTid_;
+    std::atomic<size_t> blockSize_;   //第一次分配时确定，就是控制块+TcpConnection的大小
+    std::atomic<size_t> maxCached_;
+
+    // 只有owner线程访问
+    std::vector<void*> freeBlocks_;
+    std::vector<Buffer> freeBuffers_;
+
+    // 别的线程释放的，mutex_保护
+    std::mutex mutex_;
+    std::vector<void*> remoteBlocks_;
+    std::vector<Buffer> remoteBuffers_;
+    std::atomic<size_t> remoteCount_; //owner不加锁先看一眼有没有需要收回的
+};
+
+using ConnectionPoolPtr = std::shared_ptr<ConnectionPool>;
+
+// 给std::allocate_shared用的分配器，单个对象从ConnectionPool里取
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(const ConnectionPoolPtr& pool) : pool_(pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool_(other.pool()) {}
+
+    T* allocate(size_t n)
+    {
+        if(n == 1)
+        {
+            return static_cast<T*>(pool_->allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p,size_t n)
+    {
+        if(n == 1)
+        {
+            pool_->deallocate(p,sizeof(T));
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+
+    const ConnectionPoolPtr& pool() const { return pool_; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const { return pool_ == other.pool(); }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& other) const { return pool_ != other.pool(); }
+
+private:
+    ConnectionPoolPtr pool_;
+};
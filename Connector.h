@@ -0,0 +1,60 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <atomic>
+
+class Channel;
+class EventLoop;
+
+/*
+主动发起连接，TcpClient使用
+非阻塞connect => EINPROGRESS => 等socket可写 => 检查SO_ERROR => 把连接好的sockfd交给newConnectionCallback_
+连接失败时按退避时间(0.5s起，每次翻倍，最大30s)重试
+*/
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+
+    Connector(EventLoop* loop,const InetAddress& serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback& cb)
+    { newConnectionCallback_ = cb; }
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+
+    void start();    // 可以跨线程调用
+    void restart();  // 只能在loop线程里调用
+    void stop();     // 可以跨线程调用
+
+private:
+    enum States { kDisconnected,kConnecting,kConnected };
+    static const int kMaxRetryDelayMs = 30*1000;
+    static const int kInitRetryDelayMs = 500;
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop* loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_;
+    std::atomic_int state_;
+    std::unique_ptr<Channel> channel_;
+    NewConnectionCallback newConnectionCallback_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+/*
+可选的C++20协程层，需要用 -std=c++20 编译(cmake -DMYMUDUO_CXX20=ON)
+
+    co::Task session(TcpConnectionPtr conn)
+    {
+        for(;;)
+        {
+            std::string line = co_await co::readUntil(conn,"\r\n");
+            if(line.empty()) break;              // 连接已经断开
+            conn->send(line);
+            co_await co::writeComplete(conn);    // 等待数据全部交给内核
+            co_await co::sleepFor(conn->getLoop(),0.1);
+        }
+    }
+    co::serve(server,session);
+
+协程始终运行在连接所属的EventLoop线程里:
+    - 读等待挂在连接的会话上，onMessage里条件满足时直接resume，不经过std::function
+    - 协程帧从所在loop线程的空闲链表分配，线程(也就是loop)内复用
+*/
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+namespace co
+{
+
+// 协程帧分配器，按64字节分档，每个线程一组空闲链表
+class FrameAllocator
+{
+public:
+    static void* allocate(size_t size)
+    {
+        size_t cls = sizeClass(size);
+        if(cls < kNumClasses && freeLists_[cls] != nullptr)
+        {
+            FreeNode *node = freeLists_[cls];
+            freeLists_[cls] = node->next;
+            return node;
+        }
+        return ::operator new(cls < kNumClasses ? (cls + 1) * kGranularity : size);
+    }
+
+    static void deallocate(void *p,size_t size)
+    {
+        size_t cls = sizeClass(size);
+        if(cls < kNumClasses)
+        {
+            FreeNode *node = static_cast<FreeNode*>(p);
+            node->next = freeLists_[cls];
+            freeLists_[cls] = node;
+            return;
+        }
+        ::operator delete(p);
+    }
+
+private:
+    struct FreeNode { FreeNode *next; };
+
+    static const size_t kGranularity = 64;
+    static const size_t kNumClasses = 64; // 4K以内的帧走空闲链表
+
+    static size_t sizeClass(size_t size) { return (size - 1) / kGranularity; }
+
+    static inline thread_local FreeNode *freeLists_[kNumClasses] = {};
+};
+
+// 即发即弃的协程，创建后立即运行，结束时自动销毁协程帧
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception()
+        {
+            LOG_ERROR("co::Task unhandled exception \n");
+            std::terminate();
+        }
+
+        static void* operator new(size_t size) { return FrameAllocator::allocate(size); }
+        static void operator delete(void *p,size_t size) { FrameAllocator::deallocate(p,size); }
+    };
+};
+
+class ReadAwaiter;
+
+// 挂在TcpConnection context上的协程会话，记录正在等待的协程
+struct Session
+{
+    Session() : pendingRead(nullptr),closed(false) {}
+
+    ReadAwaiter *pendingRead;
+    std::coroutine_handle<> writer;
+    bool closed;
+};
+
+inline Session* sessionOf(const TcpConnectionPtr &conn)
+{
+    return static_cast<Session*>(conn->getContext().get());
+}
+
+// 从连接的inputBuffer读取数据，连接断开时返回空字符串
+class ReadAwaiter
+{
+public:
+    enum Mode { kSome, kExactly, kUntil };
+
+    ReadAwaiter(const TcpConnectionPtr &conn,Mode mode,size_t n,std::string delim = std::string())
+        :conn_(conn)
+        ,mode_(mode)
+        ,n_(n)
+        ,delim_(std::move(delim))
+    {}
+
+    bool await_ready() { return sessionOf(conn_)->closed || tryComplete(); }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        handle_ = h;
+        sessionOf(conn_)->pendingRead = this;
+    }
+    std::string await_resume() { return std::move(result_); }
+
+    // 缓冲区里的数据满足条件时取出结果
+    bool tryComplete()
+    {
+        Buffer *buf = conn_->inputBuffer();
+        size_t readable = buf->readableBytes();
+        switch(mode_)
+        {
+        case kSome:
+            if(readable == 0) return false;
+            result_ = buf->retrieveAllAsString();
+            return true;
+        case kExactly:
+            if(readable < n_) return false;
+            result_ = buf->retrieveAsString(n_);
+            return true;
+        case kUntil:
+        {
+            const char *begin = buf->peek();
+            const char *end = begin + readable;
+            const char *pos = std::search(begin,end,delim_.begin(),delim_.end());
+            if(pos == end) return false;
+            result_ = buf->retrieveAsString(pos - begin + delim_.size());
+            return true;
+        }
+        }
+        return false;
+    }
+
+    void resume() { handle_.resume(); }
+
+private:
+    TcpConnectionPtr conn_;
+    Mode mode_;
+    size_t n_;
+    std::string delim_;
+    std::string result_;
+    std::coroutine_handle<> handle_;
+};
+
+// 读取当前已到达的全部数据
+inline ReadAwaiter readSome(const TcpConnectionPtr &conn)
+{
+    return ReadAwaiter(conn,ReadAwaiter::kSome,0);
+}
+
+// 读取恰好n个字节
+inline ReadAwaiter readExactly(const TcpConnectionPtr &conn,size_t n)
+{
+    return ReadAwaiter(conn,ReadAwaiter::kExactly,n);
+}
+
+// 读取到delim为止(包括delim)
+inline ReadAwaiter readUntil(const TcpConnectionPtr &conn,std::string delim)
+{
+    return ReadAwaiter(conn,ReadAwaiter::kUntil,0,std::move(delim));
+}
+
+// 等待所有待发送的数据(outputBuffer和排队的SharedPayload)全部写入内核
+class WriteCompleteAwaiter
+{
+public:
+    explicit WriteCompleteAwaiter(const TcpConnectionPtr &conn) : conn_(conn) {}
+
+    bool await_ready()
+    {
+        return sessionOf(conn_)->closed || conn_->outputBytes() == 0;
+    }
+    void await_suspend(std::coroutine_handle<> h) { sessionOf(conn_)->writer = h; }
+    // 返回false表示连接已经断开
+    bool await_resume() { return !sessionOf(conn_)->closed; }
+
+private:
+    TcpConnectionPtr conn_;
+};
+
+inline WriteCompleteAwaiter writeComplete(const TcpConnectionPtr &conn)
+{
+    return WriteCompleteAwaiter(conn);
+}
+
+// 在loop上睡眠seconds秒，由loop的定时器唤醒
+class SleepAwaiter
+{
+public:
+    SleepAwaiter(EventLoop *loop,double seconds) : loop_(loop),seconds_(seconds) {}
+
+    bool await_ready() { return seconds_ <= 0; }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        loop_->runAfter(seconds_,[h]() { h.resume(); });
+    }
+    void await_resume() {}
+
+private:
+    EventLoop *loop_;
+    double seconds_;
+};
+
+inline SleepAwaiter sleepFor(EventLoop *loop,double seconds)
+{
+    return SleepAwaiter(loop,seconds);
+}
+
+namespace detail
+{
+
+inline void resumeReader(Session *session)
+{
+    ReadAwaiter *reader = session->pendingRead;
+    session->pendingRead = nullptr;
+    reader->resume();
+}
+
+inline void resumeWriter(Session *session)
+{
+    std::coroutine_handle<> writer = session->writer;
+    session->writer = nullptr;
+    writer.resume();
+}
+
+} // namespace detail
+
+/*
+接管server的连接/消息/写完成回调，每个新连接启动一个handler协程
+Handler的形式为 co::Task handler(TcpConnectionPtr conn)
+*/
+template <typename Handler>
+void serve(TcpServer &server,Handler handler)
+{
+    server.setConnectionCallback([handler](const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            conn->setContext(std::make_shared<Session>());
+            handler(conn);
+            return;
+        }
+        Session *session = sessionOf(conn);
+        if(session == nullptr)
+        {
+            return;
+        }
+        //连接断开，唤醒所有等待中的协程，让它们看到closed
+        session->closed = true;
+        if(session->pendingRead)
+        {
+            detail::resumeReader(session);
+        }
+        if(session->writer)
+        {
+            detail::resumeWriter(session);
+        }
+    });
+
+    server.setMessageCallback([](const TcpConnectionPtr &conn,Buffer*,Timestamp)
+    {
+        Session *session = sessionOf(conn);
+        if(session && session->pendingRead && session->pendingRead->tryComplete())
+        {
+            detail::resumeReader(session);
+        }
+    });
+
+    server.setWriteCompleteCallback([](const TcpConnectionPtr &conn)
+    {
+        Session *session = sessionOf(conn);
+        if(session && session->writer && conn->outputBytes() == 0)
+        {
+            detail::resumeWriter(session);
+        }
+    });
+}
+
+} // namespace co
+
+#endif
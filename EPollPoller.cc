@@ -5,6 +5,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <string.h>
+#include <algorithm>
 
 // channel未添加到poller中
 const int kNew = -1;  //channel的成员index_ = -1
@@ -17,6 +18,8 @@ EPollPoller::EPollPoller(EventLoop *loop)
     :Poller(loop)
     ,epollfd_(::epoll_create1(EPOLL_CLOEXEC))
     ,events_(kInitEventListSize)     //vector<epoll_events>
+    ,maxEvents_(kDefaultMaxEvents)
+    ,idlePolls_(0)
 {
     if(epollfd_ < 0)
     {
@@ -31,7 +34,7 @@ EPollPoller::~EPollPoller()
 
 Timestamp EPollPoller::poll(int timeoutMs,ChannelList *activeChannels)
 {
-    LOG_INFO("func=%s => fd total count:%lu \n",__FUNCTION__,channels_.size());
+    LOG_INFO("func=%s => fd total count:%lu \n",__FUNCTION__,numChannels_);
     int numEvents = ::epoll_wait(epollfd_,&*events_.begin(),static_cast<int>(events_.size()),timeoutMs); //&*events_.begin()表示该vector数组的首位置
     int saveErrno = errno;
     Timestamp now(Timestamp::now());
@@ -40,14 +43,12 @@ Timestamp EPollPoller::poll(int timeoutMs,ChannelList *activeChannels)
     {
         LOG_INFO("%d events happened \n",numEvents);
         fillActiveChannels(numEvents,activeChannels);
-        if(numEvents == events_.size())
-        {
-            events_.resize(events_.size()*2);
-        }
+        resizeEventList(numEvents);
     }
     else if(numEvents == 0)
     {
         LOG_DEBUG("%s timeout! \n",__FUNCTION__);
+        resizeEventList(0);
     }
     else //发生错误
     {
@@ -60,6 +61,39 @@ Timestamp EPollPoller::poll(int timeoutMs,ChannelList *activeChannels)
     return now;
 }
 
+void EPollPoller::setMaxEvents(int maxEvents)
+{
+    maxEvents_ = std::max(maxEvents,1);
+    if(static_cast<int>(events_.size()) > maxEvents_)
+    {
+        events_.resize(maxEvents_);
+        events_.shrink_to_fit();
+    }
+}
+
+void EPollPoller::resizeEventList(int numEvents)
+{
+    int size = static_cast<int>(events_.size());
+    if(numEvents == size && size < maxEvents_)
+    {
+        events_.resize(std::min(size * 2,maxEvents_));
+        idlePolls_ = 0;
+    }
+    else if(numEvents < size / 4 && size > kInitEventListSize)
+    {
+        if(++idlePolls_ >= kShrinkPolls)
+        {
+            events_.resize(size / 2 > kInitEventListSize ? size / 2 : kInitEventListSize);
+            events_.shrink_to_fit();
+            idlePolls_ = 0;
+        }
+    }
+    else
+    {
+        idlePolls_ = 0;
+    }
+}
+
 // channel update remove => EventLoop updateChannel removeChannel => Poller update remove
 /*
                 EventLoop => Poller.poll
@@ -75,8 +109,7 @@ void EPollPoller::updateChannel(Channel *channel)
     {
         if(index == kNew)
         {
-            int fd = channel->fd();
-            channels_[fd] = channel;
+            addChannel(channel->fd(),channel);
         }
 
         channel->set_index(kAdded);
@@ -101,7 +134,7 @@ void EPollPoller::updateChannel(Channel *channel)
 void EPollPoller::removeChannel(Channel *channel)
 {
     int fd = channel->fd();
-    channels_.erase(fd);
+    eraseChannel(fd);
 
     LOG_INFO("function=%s => fd=%d \n",__FUNCTION__,fd);
 
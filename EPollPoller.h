@@ -24,15 +24,27 @@ public:
     Timestamp poll(int timeoutMs,ChannelList *activeChannels) override;
     void updateChannel(Channel *channel) override;
     void removeChannel(Channel *channel) override;
+
+    /*
+    events_从kInitEventListSize开始，一次poll填满就翻倍，最多到maxEvents
+    突发过后连续kShrinkPolls次poll都用不到四分之一时减半，把内存还回去
+    */
+    void setMaxEvents(int maxEvents) override;
 private:
     static const int kInitEventListSize = 16;
+    static const int kDefaultMaxEvents = 4096;
+    static const int kShrinkPolls = 128;
     //填写活跃链接
     void fillActiveChannels(int numEvents, ChannelList* activeChannels) const;
     //更新channel通道
     void update(int operation, Channel* channel);
+    //根据本次poll返回的事件数调整events_的大小
+    void resizeEventList(int numEvents);
 
     using EventList = std::vector<epoll_event>;
 
     int epollfd_;
     EventList events_;
+    int maxEvents_;
+    int idlePolls_; //连续用不到四分之一events_的poll次数
 };
@@ -2,6 +2,10 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "ConnectionPool.h"
+#include "Clock.h"
+#include "MemoryAccountant.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
@@ -29,11 +33,19 @@ int createEventfd()
 EventLoop::EventLoop()
     :looping_(false)
     ,quit_(false)
-    ,callingPendingFunctors_(false)
     ,threadId_(CurrentThread::tid())
+    ,pollReturnNs_(0)
     ,poller_(Poller::newDefaultPoller(this))
+    ,timerQueue_(new TimerQueue(this))
+    ,connectionPool_(std::make_shared<ConnectionPool>())
+    ,memoryAccount_(MemoryAccountant::currentAccount())
     ,wakeupFd_(createEventfd())
     ,weakupChannel_(new Channel(this,wakeupFd_))
+    ,throttledCursor_(0)
+    ,callingPendingFunctors_(false)
+    ,pendingCount_(0)
+    ,lastIterationNs_(0)
+    ,iterationStartNs_(0)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n",this,threadId_);
     if(t_loopInThisThread)
@@ -81,22 +93,55 @@ void EventLoop::loop()
     {
         activeChannels_.clear();
         //监听两类fd 一种是client的fd,lfd 一种是wakefd，mainLoop和subloop之间的fd
+        iterationStartNs_.store(0,std::memory_order_relaxed);
         pollReturnTime_ = poller_->poll(kPollTimeMs,&activeChannels_);
-        for(Channel *   channel : activeChannels_)
-        {
-            // Poller监听哪些channel发生事件了，然后上报给EventLoop，通知channel处理相应的事件
-            channel->handleEvent(pollReturnTime_);
-        }
+        pollReturnNs_ = Clock::nowNs();
+        iterationStartNs_.store(pollReturnNs_,std::memory_order_relaxed);
+        dispatchActiveChannels();
         //执行当前EventLoop事件循环需要处理的回调操作
         /*
          事先注册一个回调cb （需要subloop来执行）
         */
         doPendingFunctors();
+        lastIterationNs_.store(Clock::nowNs() - pollReturnNs_,std::memory_order_relaxed);
     }
     LOG_INFO("EventLoop %p stop looping. \n",this);
     looping_ = false;
 }
 
+/*
+分发本轮的活跃channel
+poller工作在LT模式，一个连接用完了本轮的读写预算(TcpConnection::IoBudget)之后，剩下的数据下一轮还会上报，
+这样的channel被标记为throttled。本轮先处理其它channel，保证小请求的连接不会被大流量的连接挤占，
+最后再处理throttled的channel，并且每轮换一个起点轮转，让它们之间也能公平地继续处理
+*/
+void EventLoop::dispatchActiveChannels()
+{
+    throttledChannels_.clear();
+    for(Channel *channel : activeChannels_)
+    {
+        if(channel->throttled())
+        {
+            throttledChannels_.push_back(channel);
+        }
+        else
+        {
+            // Poller监听哪些channel发生事件了，然后上报给EventLoop，通知channel处理相应的事件
+            channel->handleEvent(pollReturnTime_);
+        }
+    }
+
+    const size_t n = throttledChannels_.size();
+    if(n > 0)
+    {
+        size_t start = throttledCursor_++ % n;
+        for(size_t i=0;i<n;i++)
+        {
+            throttledChannels_[(start+i)%n]->handleEvent(pollReturnTime_);
+        }
+    }
+}
+
 //退出事件循环  1.loop在自己的线程中调用quit  2.在非当前loop的线程中，调用loop的quit
 /*
                     MainLoop
@@ -132,6 +177,7 @@ void EventLoop::queueInLoop(Functor cb)
     {
         std::unique_lock<std::mutex> lock(mutex_);
         pendingFunctors_.emplace_back(cb);
+        pendingCount_.store(pendingFunctors_.size(),std::memory_order_relaxed);
     }
     // 唤醒相应的相应的，需要执行上面回调操作的loop的线程
     // 或者 当前正在进行回调，又有了新的回调，唤醒loop所在线程，继续执行
@@ -153,6 +199,23 @@ void EventLoop::wakeup()
     }
 }
 
+TimerId EventLoop::runAfter(double delay,Functor cb)
+{
+    int64_t when = TimerQueue::now() + static_cast<int64_t>(delay * 1000000);
+    return timerQueue_->addTimer(std::move(cb),when,0);
+}
+
+TimerId EventLoop::runEvery(double interval,Functor cb)
+{
+    int64_t micros = static_cast<int64_t>(interval * 1000000);
+    return timerQueue_->addTimer(std::move(cb),TimerQueue::now() + micros,micros);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // EventLoop的方法 -> Poller的方法
 void EventLoop::updateChannel(Channel* channel)
 {
@@ -169,6 +232,23 @@ bool EventLoop::hasChannel(Channel* channel)
     return poller_->hasChannel(channel);
 }
 
+int64_t EventLoop::lagNs() const
+{
+    int64_t start = iterationStartNs_.load(std::memory_order_relaxed);
+    if(start == 0)
+    {
+        return 0;
+    }
+    int64_t current = Clock::nowNs() - start;
+    int64_t last = lastIterationNs_.load(std::memory_order_relaxed);
+    return current > last ? current : last;
+}
+
+void EventLoop::setMaxPollEvents(int maxEvents)
+{
+    poller_->setMaxEvents(maxEvents);
+}
+
 //执行回调
 void EventLoop::doPendingFunctors()
 {
@@ -178,6 +258,7 @@ void EventLoop::doPendingFunctors()
     {
         std::lock_guard<std::mutex> lock(mutex_);
         functors.swap(pendingFunctors_);
+        pendingCount_.store(0,std::memory_order_relaxed);
     }
 
     for(const Functor& functor : functors)
@@ -4,6 +4,8 @@
 #include "Timestamp.h"  
 #include "Channel.h"
 #include "CurrentThread.h"
+#include "TimerId.h"
+#include "MemoryAccountant.h"
  
 #include <functional>
 #include <vector>
@@ -13,6 +15,8 @@
 
 // Reator, at most one per thread
 class Poller;
+class TimerQueue;
+class ConnectionPool;
 // class Channel;
 
 //时间循环类 主要包括了两大模块 Channel Poller(epoll的抽象)
@@ -30,6 +34,16 @@ public:
     void quit();
 
     Timestamp pollReturnTime() const { return pollReturnTime_;}
+    // 本轮poll返回时的单调时钟(Clock::nowNs)，回调里拿来算耗时不用再读时钟
+    int64_t pollReturnNs() const { return pollReturnNs_; }
+
+    // 负载指标，可以跨线程读取，给TcpServer的过载保护用
+    // 上一轮从poll返回到处理完回调花的时间，loop越忙越大
+    int64_t lastIterationNs() const { return lastIterationNs_; }
+    // loop的滞后: 正在处理事件时是本轮已经花的时间和上一轮耗时中大的那个，在poll里等事件时为0
+    int64_t lagNs() const;
+    // 排队等着执行的回调个数
+    size_t pendingFunctorCount() const { return pendingCount_; }
 
     // 在当前loop中执行cb
     void runInLoop(Functor cb);
@@ -39,16 +53,33 @@ public:
     // 唤醒loop所在的线程
     void wakeup();
 
+    // delay秒之后在loop线程里执行cb，可以跨线程调用
+    TimerId runAfter(double delay,Functor cb);
+    // 每隔interval秒在loop线程里执行一次cb
+    TimerId runEvery(double interval,Functor cb);
+    void cancel(TimerId timerId);
+
     // EventLoop的方法 -> Poller的方法
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
     bool hasChannel(Channel* channel);
 
+    // 一次epoll_wait最多返回的事件数(默认4096)，在loop线程里或者loop()之前调用
+    void setMaxPollEvents(int maxEvents);
+
+    // 这个loop上的TcpConnection都从这里分配，见ConnectionPool
+    const std::shared_ptr<ConnectionPool>& connectionPool() const { return connectionPool_; }
+
+    // 这个loop的缓冲区内存账户，loop上连接的Buffer都记在这里，见MemoryAccountant
+    MemoryAccount* memoryAccount() const { return memoryAccount_; }
+    int64_t bufferBytes() const { return memoryAccount_->bytes.load(std::memory_order_relaxed); }
+
     // 判断EventLoop对象是否在自己的线程里面
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 private:
     void handleRead(); //唤醒wakeup
     void doPendingFunctors();  //执行回调
+    void dispatchActiveChannels(); //分发本轮发生事件的channel
 
     using ChannelList = std::vector<Channel*>;
 
@@ -57,7 +88,11 @@ private:
     
     const pid_t threadId_; //记录当前loop所在的线程id
     Timestamp pollReturnTime_; //poller返回发生事件的channels的时间点
+    int64_t pollReturnNs_;
     std::unique_ptr<Poller> poller_;
+    std::unique_ptr<TimerQueue> timerQueue_;
+    std::shared_ptr<ConnectionPool> connectionPool_;
+    MemoryAccount* memoryAccount_;
     /*
         eventfd()，采用的是线程间的通讯机制 muduo
         socketpair，主loop和子loop都创建socketpair，双向通信，走的网络通信libevent
@@ -66,8 +101,13 @@ private:
     std::unique_ptr<Channel> weakupChannel_;
 
     ChannelList activeChannels_;
+    ChannelList throttledChannels_; //上一轮用完读写预算的channel，本轮排在最后轮转处理
+    size_t throttledCursor_;         //throttledChannels_轮转的起点
 
     std::atomic_bool callingPendingFunctors_; //标识当前loop是否有需要执行的回调操作
     std::vector<Functor> pendingFunctors_; //存储loop所有需要执行的回调操作
+    std::atomic<size_t> pendingCount_;     //pendingFunctors_.size()，不加锁读取
+    std::atomic<int64_t> lastIterationNs_;
+    std::atomic<int64_t> iterationStartNs_; //本轮poll返回的时间，在poll里等待时为0
     std::mutex mutex_;  //用来保护上面vector容器的线程安全操作
 };
\ No newline at end of file
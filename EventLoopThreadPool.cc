@@ -30,7 +30,7 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     }
 
     //整个服务端只有一个线程，运行着baseloop
-    if(numThreads_ == 0 || cb)
+    if(numThreads_ == 0 && cb)
     {
         cb(baseLoop_);
     }
@@ -2,34 +2,111 @@
 
 #include<strings.h>
 #include<string.h>
+#include<stddef.h>
 // #include<iostream>
 
 InetAddress::InetAddress(uint16_t port,std::string ip)
 {
     bzero(&addr_,sizeof(addr_));
-    addr_.sin_port = htons(port);
-    addr_.sin_family = AF_INET;
-    addr_.sin_addr.s_addr = inet_addr(ip.c_str());
+    if(ip.find(':') != std::string::npos)
+    {
+        sockaddr_in6 *addr6 = reinterpret_cast<sockaddr_in6*>(&addr_);
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port = htons(port);
+        ::inet_pton(AF_INET6,ip.c_str(),&addr6->sin6_addr);
+        len_ = sizeof(sockaddr_in6);
+    }
+    else
+    {
+        sockaddr_in *addr4 = reinterpret_cast<sockaddr_in*>(&addr_);
+        addr4->sin_port = htons(port);
+        addr4->sin_family = AF_INET;
+        addr4->sin_addr.s_addr = inet_addr(ip.c_str());
+        len_ = sizeof(sockaddr_in);
+    }
+}
+
+InetAddress::InetAddress(const sockaddr_in6& addr)
+{
+    setSockAddr(reinterpret_cast<const sockaddr*>(&addr),sizeof(addr));
+}
+
+InetAddress InetAddress::fromUnixPath(const std::string& path)
+{
+    sockaddr_un addr;
+    bzero(&addr,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path,path.c_str(),sizeof(addr.sun_path)-1);
+    socklen_t len = static_cast<socklen_t>(offsetof(sockaddr_un,sun_path) + strlen(addr.sun_path) + 1);
+    return InetAddress(reinterpret_cast<const sockaddr*>(&addr),len);
+}
+
+void InetAddress::setSockAddr(const sockaddr_in &addr)
+{
+    setSockAddr(reinterpret_cast<const sockaddr*>(&addr),sizeof(addr));
+}
+
+void InetAddress::setSockAddr(const sockaddr* addr,socklen_t len)
+{
+    bzero(&addr_,sizeof(addr_));
+    if(len > sizeof(addr_))
+    {
+        len = sizeof(addr_);
+    }
+    memcpy(&addr_,addr,len);
+    len_ = len;
 }
 
 std::string InetAddress::toIp() const
 {
-    char buf[64] = {0};
-    ::inet_ntop(AF_INET,&addr_.sin_addr,buf,sizeof(buf));
-    return buf;
+    char buf[INET6_ADDRSTRLEN] = {0};
+    switch(family())
+    {
+    case AF_INET:
+        ::inet_ntop(AF_INET,&reinterpret_cast<const sockaddr_in*>(&addr_)->sin_addr,buf,sizeof(buf));
+        return buf;
+    case AF_INET6:
+        ::inet_ntop(AF_INET6,&reinterpret_cast<const sockaddr_in6*>(&addr_)->sin6_addr,buf,sizeof(buf));
+        return buf;
+    case AF_UNIX:
+        //accept得到的对端地址通常是匿名的，没有路径
+        if(len_ > offsetof(sockaddr_un,sun_path))
+        {
+            return reinterpret_cast<const sockaddr_un*>(&addr_)->sun_path;
+        }
+        return std::string();
+    default:
+        return std::string();
+    }
 }
 std::string InetAddress::toIpPort() const
 {
-    char buf[64] = {0};
-    ::inet_ntop(AF_INET,&addr_.sin_addr,buf,sizeof(buf));
-    size_t end = strlen(buf);
-    uint16_t port = ntohs(addr_.sin_port);
-    sprintf(buf+end,":%u",port);
+    char buf[128] = {0};
+    switch(family())
+    {
+    case AF_INET6:
+        snprintf(buf,sizeof(buf),"[%s]:%u",toIp().c_str(),toPort());
+        break;
+    case AF_UNIX:
+        snprintf(buf,sizeof(buf),"unix:%s",toIp().c_str());
+        break;
+    default:
+        snprintf(buf,sizeof(buf),"%s:%u",toIp().c_str(),toPort());
+        break;
+    }
     return buf;
 }
 uint16_t InetAddress::toPort() const
 {
-    return ntohs(addr_.sin_port);
+    switch(family())
+    {
+    case AF_INET:
+        return ntohs(reinterpret_cast<const sockaddr_in*>(&addr_)->sin_port);
+    case AF_INET6:
+        return ntohs(reinterpret_cast<const sockaddr_in6*>(&addr_)->sin6_port);
+    default:
+        return 0;
+    }
 }
 
 // int main()
@@ -39,4 +116,4 @@ uint16_t InetAddress::toPort() const
 //     std::cout<<addr.toIp()<<" : "<<addr.toIpPort()<<" : "<<addr.toPort()<<std::endl;
 
 //     return 0;
-// }
\ No newline at end of file
+// }
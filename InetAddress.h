@@ -2,21 +2,35 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <string>
 
-//封装socket地址类型
+//封装socket地址类型，支持AF_INET、AF_INET6和AF_UNIX
 class InetAddress
 {
 public:
+    // ip里包含':'时按IPv6解析，例如 InetAddress(8000,"::1")
     explicit InetAddress(uint16_t port = 0,std::string ip = "127.0.0.1");
-    explicit InetAddress(const sockaddr_in& addr) : addr_(addr) {}
+    explicit InetAddress(const sockaddr_in& addr) { setSockAddr(addr); }
+    explicit InetAddress(const sockaddr_in6& addr);
+    InetAddress(const sockaddr* addr,socklen_t len) { setSockAddr(addr,len); }
 
+    // unix域socket地址
+    static InetAddress fromUnixPath(const std::string& path);
+
+    sa_family_t family() const { return addr_.ss_family; }
+
+    // AF_UNIX时toIp返回socket文件路径，toIpPort返回"unix:路径"，toPort返回0
     std::string toIp() const;
     std::string toIpPort() const;
     uint16_t toPort() const;
 
-    const sockaddr_in* getSockAddr() const {return &addr_;}
-    void setSockAddr(const sockaddr_in &addr) {addr_ = addr;}
+    const sockaddr* getSockAddr() const { return reinterpret_cast<const sockaddr*>(&addr_); }
+    socklen_t getSockLen() const { return len_; }
+    void setSockAddr(const sockaddr_in &addr);
+    void setSockAddr(const sockaddr* addr,socklen_t len);
 private:
-    sockaddr_in addr_; 
-};
\ No newline at end of file
+    sockaddr_storage addr_;
+    socklen_t len_;
+};
@@ -1,7 +1,33 @@
 #include"Logger.h"
 
 #include "iostream"
-    
+#include <stdio.h>
+#include <time.h>
+
+/*
+日志的时间前缀"2024/01/02 03:04:05"每秒才变一次，每个线程缓存上一次格式化的结果，
+同一秒内只需要补上".微秒"，不用每条日志都调用localtime_r
+*/
+static thread_local time_t t_lastSecond = -1;
+static thread_local char t_datePrefix[64]; //按int字段的最大宽度留足空间
+
+static void formatTime(char* buf,size_t len)
+{
+    Timestamp now(Timestamp::now());
+    time_t seconds = now.secondsSinceEpoch();
+    if(seconds != t_lastSecond)
+    {
+        t_lastSecond = seconds;
+        struct tm tm_time;
+        ::localtime_r(&seconds,&tm_time);
+        snprintf(t_datePrefix,sizeof t_datePrefix,"%4d/%02d/%02d %02d:%02d:%02d",
+            tm_time.tm_year+1900,tm_time.tm_mon+1,tm_time.tm_mday,
+            tm_time.tm_hour,tm_time.tm_min,tm_time.tm_sec);
+    }
+    int microseconds = static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+    snprintf(buf,len,"%s.%06d",t_datePrefix,microseconds);
+}
+
 //获取日志唯一的实力对象
 Logger& Logger::instance()
 {
@@ -36,5 +62,7 @@ void Logger::log(std::string msg)
     }
 
     //打印时间和msg
-    std::cout<<Timestamp::now().toString()<<" : "<<msg<<std::endl;
+    char timeBuf[80];
+    formatTime(timeBuf,sizeof timeBuf);
+    std::cout<<timeBuf<<" : "<<msg<<std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "MemoryAccountant.h"
+#include "CurrentThread.h"
+
+#include <mutex>
+
+std::atomic<int64_t> MemoryAccountant::totalBytes_(0);
+std::atomic<size_t> MemoryAccountant::budget_(0);
+std::atomic<size_t> MemoryAccountant::backpressure_(0);
+
+namespace
+{
+// 所有创建过的账户，线程退出后账户也保留，上面可能还记着没释放的Buffer
+std::mutex g_accountsMutex;
+std::vector<MemoryAccount*> g_accounts;
+thread_local MemoryAccount* t_account = nullptr;
+}
+
+MemoryAccount* MemoryAccountant::currentAccount()
+{
+    if(t_account == nullptr)
+    {
+        MemoryAccount* account = new MemoryAccount;
+        account->tid = CurrentThread::tid();
+        std::lock_guard<std::mutex> lock(g_accountsMutex);
+        g_accounts.push_back(account);
+        t_account = account;
+    }
+    return t_account;
+}
+
+void MemoryAccountant::setBudget(size_t budget,size_t backpressure)
+{
+    if(backpressure == 0 || backpressure > budget)
+    {
+        backpressure = budget / 4 * 3;
+    }
+    budget_ = budget;
+    backpressure_ = backpressure;
+}
+
+std::vector<MemoryAccountant::Usage> MemoryAccountant::usage()
+{
+    std::vector<Usage> result;
+    std::lock_guard<std::mutex> lock(g_accountsMutex);
+    for(MemoryAccount* account : g_accounts)
+    {
+        Usage item;
+        item.tid = account->tid;
+        item.bytes = account->bytes.load(std::memory_order_relaxed);
+        result.push_back(item);
+    }
+    return result;
+}
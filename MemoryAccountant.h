@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+// 一个线程的缓冲区内存账户，EventLoop线程的账户就是这个loop的用量；创建后不释放
+struct MemoryAccount
+{
+    MemoryAccount() : bytes(0),tid(0) {}
+
+    std::atomic<int64_t> bytes;
+    int tid;
+};
+
+/*
+进程级的缓冲区内存记账
+
+每个Buffer记在一个账户上(默认是创建它的线程的账户，TcpConnection把自己的Buffer改记到所属loop的账户)，
+底层存储容量变化时把差值记到账户和全局总量上，析构时退回；只在扩容/释放时做两次relaxed原子加，不加锁
+
+设置预算之后:
+    总量超过backpressure: 所有连接暂停读取(关掉EPOLLIN)，数据留在内核里由TCP流控反压对端，输出照常写出释放内存
+    总量超过budget:       TcpServer定期在每个subloop里关掉占用缓冲区最多的连接，直到回到预算以内
+*/
+class MemoryAccountant
+{
+public:
+    // 当前线程的账户，第一次调用时创建
+    static MemoryAccount* currentAccount();
+
+    static void charge(MemoryAccount* account,int64_t delta)
+    {
+        account->bytes.fetch_add(delta,std::memory_order_relaxed);
+        totalBytes_.fetch_add(delta,std::memory_order_relaxed);
+    }
+
+    // 所有Buffer的存储容量之和
+    static int64_t totalBytes() { return totalBytes_.load(std::memory_order_relaxed); }
+
+    // budget为0表示不限制；backpressure为0时取budget的3/4
+    static void setBudget(size_t budget,size_t backpressure = 0);
+    static size_t budget() { return budget_; }
+    static size_t backpressure() { return backpressure_; }
+
+    static bool readBackpressure()
+    {
+        size_t limit = backpressure_.load(std::memory_order_relaxed);
+        return limit > 0 && totalBytes() >= static_cast<int64_t>(limit);
+    }
+    static bool overBudget()
+    {
+        size_t limit = budget_.load(std::memory_order_relaxed);
+        return limit > 0 && totalBytes() > static_cast<int64_t>(limit);
+    }
+
+    struct Usage
+    {
+        int tid;
+        int64_t bytes;
+    };
+    // 每个线程账户的用量
+    static std::vector<Usage> usage();
+
+private:
+    static std::atomic<int64_t> totalBytes_;
+    static std::atomic<size_t> budget_;
+    static std::atomic<size_t> backpressure_;
+};
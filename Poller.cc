@@ -1,12 +1,39 @@
 #include "Poller.h"
 #include "Channel.h"
 
+#include <algorithm>
+
 Poller::Poller(EventLoop *loop)
-    :ownerLoop_(loop)
+    :numChannels_(0)
+    ,ownerLoop_(loop)
 {}
 
 bool Poller::hasChannel(Channel* channel) const
 {
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    size_t fd = static_cast<size_t>(channel->fd());
+    return fd < channels_.size() && channels_[fd] == channel;
+}
+
+void Poller::addChannel(int fd,Channel* channel)
+{
+    size_t index = static_cast<size_t>(fd);
+    if(index >= channels_.size())
+    {
+        channels_.resize(std::max(index + 1,channels_.size() * 2),nullptr);
+    }
+    if(channels_[index] == nullptr)
+    {
+        ++numChannels_;
+    }
+    channels_[index] = channel;
+}
+
+void Poller::eraseChannel(int fd)
+{
+    size_t index = static_cast<size_t>(fd);
+    if(index < channels_.size() && channels_[index] != nullptr)
+    {
+        channels_[index] = nullptr;
+        --numChannels_;
+    }
 }
\ No newline at end of file
@@ -3,9 +3,7 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 
-#include<unordered_map>
 #include<vector>
-#include<map>
 
 class Channel;
 class EventLoop;
@@ -27,13 +25,19 @@ public:
     //判断参数channel 是否在当前poller中
     bool hasChannel(Channel* channel) const;
 
+    //一次poll最多返回的事件数，默认实现忽略
+    virtual void setMaxEvents(int /*maxEvents*/) {}
+
     //EventLoop可以通过该接口获取默认的IO复用的具体实现(poll or epoll or select)
     static Poller* newDefaultPoller(EventLoop* loop); 
 protected:
-    //map的key就是sockfd   value: sockfd所属的通道类型
-    using ChannelMap = std::unordered_map<int,Channel*>;
-    // typedef std::map<int,Channel*> ChannelMap;
+    //fd是从小往上分配的稠密整数，直接用fd做下标: channels_[sockfd] = sockfd所属的通道，没有注册的位置是nullptr
+    using ChannelMap = std::vector<Channel*>;
     ChannelMap channels_;
+    size_t numChannels_; //channels_里非空的个数
+
+    void addChannel(int fd,Channel* channel);
+    void eraseChannel(int fd);
 
 private:
     EventLoop* ownerLoop_; //定义Poller所属的事件循环EventLoop 
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+
+// 连接一个方向上的限速，字段为0表示不限制
+struct RateLimit
+{
+    explicit RateLimit(double bytesPerSecondArg = 0,double messagesPerSecondArg = 0,
+        double burstBytesArg = 0,double burstMessagesArg = 0)
+        :bytesPerSecond(bytesPerSecondArg)
+        ,messagesPerSecond(messagesPerSecondArg)
+        ,burstBytes(burstBytesArg)
+        ,burstMessages(burstMessagesArg)
+    {}
+
+    bool limited() const { return bytesPerSecond > 0 || messagesPerSecond > 0; }
+
+    double bytesPerSecond;    //每秒字节数
+    double messagesPerSecond; //每秒消息数，入方向是回调messageCallback_的次数；出方向不使用
+    double burstBytes;        //桶的容量，0表示一秒的量
+    double burstMessages;
+};
+
+/*
+令牌桶: 按rate匀速补充令牌，最多攒burst个；只在所属的loop线程里使用，不加锁
+时间用Clock::nowNs()的纳秒值(EventLoop::pollReturnNs())
+*/
+class TokenBucket
+{
+public:
+    TokenBucket() : rate_(0),burst_(0),tokens_(0),lastNs_(0) {}
+
+    void reset(double rate,double burst,int64_t nowNs)
+    {
+        rate_ = rate > 0 ? rate : 0;
+        burst_ = burst > 0 ? burst : rate_;
+        tokens_ = burst_;
+        lastNs_ = nowNs;
+    }
+
+    bool limited() const { return rate_ > 0; }
+    double tokens() const { return tokens_; }
+
+    void refill(int64_t nowNs)
+    {
+        if(nowNs > lastNs_)
+        {
+            tokens_ += rate_ * static_cast<double>(nowNs - lastNs_) / 1e9;
+            if(tokens_ > burst_)
+            {
+                tokens_ = burst_;
+            }
+            lastNs_ = nowNs;
+        }
+    }
+
+    void consume(double n) { tokens_ -= n; }
+
+    // 令牌还够一个时返回0；否则返回要等多少秒，等到至少补够1/100秒的量(最多一桶)，
+    // 避免每补一个令牌就醒一次
+    double waitSeconds() const
+    {
+        if(!limited() || tokens_ >= 1)
+        {
+            return 0;
+        }
+        double need = rate_ / 100;
+        if(need > burst_)
+        {
+            need = burst_;
+        }
+        if(need < 1)
+        {
+            need = 1;
+        }
+        return (need - tokens_) / rate_;
+    }
+
+private:
+    double rate_;
+    double burst_;
+    double tokens_;
+    int64_t lastNs_;
+};
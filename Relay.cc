@@ -0,0 +1,204 @@
+#include "Relay.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <functional>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+Relay::Relay(const TcpConnectionPtr& downstream,
+    const TcpConnectionPtr& upstream,
+    size_t highWaterMark,
+    size_t lowWaterMark)
+    :capacity_(0)
+    ,highWaterMark_(highWaterMark)
+    ,lowWaterMark_(lowWaterMark)
+    ,closed_(false)
+{
+    if(downstream->getLoop() != upstream->getLoop())
+    {
+        LOG_FATAL("%s:%s:%d relay connections belong to different loops! \n",__FILE__,__FUNCTION__,__LINE__);
+    }
+    directions_[0].src = downstream;
+    directions_[0].dst = upstream;
+    directions_[1].src = upstream;
+    directions_[1].dst = downstream;
+
+    for(Direction& dir : directions_)
+    {
+        if(::pipe2(dir.pipefd,O_NONBLOCK | O_CLOEXEC) < 0)
+        {
+            LOG_FATAL("%s:%s:%d pipe2 err:%d \n",__FILE__,__FUNCTION__,__LINE__,errno);
+        }
+        //把pipe扩到高水位那么大，内核会向上取整到页的2次幂，超过pipe-max-size时保持默认大小
+        int size = ::fcntl(dir.pipefd[1],F_SETPIPE_SZ,static_cast<int>(highWaterMark_));
+        if(size < 0)
+        {
+            size = ::fcntl(dir.pipefd[1],F_GETPIPE_SZ);
+        }
+        capacity_ = static_cast<size_t>(size);
+    }
+    if(highWaterMark_ > capacity_)
+    {
+        highWaterMark_ = capacity_;
+    }
+    if(lowWaterMark_ >= highWaterMark_)
+    {
+        lowWaterMark_ = highWaterMark_ / 2;
+    }
+}
+
+Relay::~Relay()
+{
+    for(Direction& dir : directions_)
+    {
+        ::close(dir.pipefd[0]);
+        ::close(dir.pipefd[1]);
+    }
+}
+
+void Relay::start()
+{
+    for(Direction& dir : directions_)
+    {
+        TcpConnectionPtr src = dir.src.lock();
+        TcpConnectionPtr dst = dir.dst.lock();
+        if(!src || !dst)
+        {
+            close();
+            return;
+        }
+        //接管之前已经读进用户态的数据，只能拷贝一次发出去
+        Buffer* input = src->inputBuffer();
+        if(input->readableBytes() > 0)
+        {
+            dst->send(input->retrieveAllAsString());
+        }
+        //回调持有Relay，Relay只弱引用两条连接，两条连接都销毁之后Relay随之释放
+        src->setRawReadCallback(std::bind(&Relay::handleReadable,shared_from_this(),&dir,std::placeholders::_1));
+        dst->setRawWriteCallback(std::bind(&Relay::handleWritable,shared_from_this(),&dir));
+    }
+    for(Direction& dir : directions_)
+    {
+        dir.src.lock()->startRead();
+    }
+}
+
+void Relay::close()
+{
+    if(closed_)
+    {
+        return;
+    }
+    closed_ = true;
+    for(Direction& dir : directions_)
+    {
+        TcpConnectionPtr src = dir.src.lock();
+        if(src)
+        {
+            src->forceClose();
+        }
+    }
+}
+
+// src可读: socket => pipe，然后尽量把pipe里的数据写给dst
+void Relay::handleReadable(Direction* dir,Timestamp /*receiveTime*/)
+{
+    TcpConnectionPtr src = dir->src.lock();
+    TcpConnectionPtr dst = dir->dst.lock();
+    if(closed_ || !src || !dst)
+    {
+        close();
+        return;
+    }
+
+    if(dir->buffered < capacity_)
+    {
+        ssize_t n = ::splice(src->fd(),nullptr,dir->pipefd[1],nullptr,capacity_ - dir->buffered,
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(n > 0)
+        {
+            dir->buffered += n;
+        }
+        else if(n == 0)
+        {
+            dir->eof = true;
+            src->stopRead(); //EOF在LT模式下会一直可读
+        }
+        else if(errno != EAGAIN)
+        {
+            LOG_ERROR("Relay::handleReadable %s splice err:%d \n",src->name().c_str(),errno);
+            close();
+            return;
+        }
+    }
+
+    pump(dir,src,dst);
+    if(dir->buffered >= highWaterMark_ && src->isReading())
+    {
+        src->stopRead();
+    }
+}
+
+// dst可写，并且dst的outputBuffer_已经写空
+void Relay::handleWritable(Direction* dir)
+{
+    TcpConnectionPtr src = dir->src.lock();
+    TcpConnectionPtr dst = dir->dst.lock();
+    if(closed_ || !src || !dst)
+    {
+        close();
+        return;
+    }
+    pump(dir,src,dst);
+}
+
+// pipe => dst socket
+void Relay::pump(Direction* dir,const TcpConnectionPtr& src,const TcpConnectionPtr& dst)
+{
+    //dst上还有start()之前拷贝进去的数据，等它们先写完
+    if(dst->outputBuffer()->readableBytes() > 0)
+    {
+        dst->watchWritable(true);
+        return;
+    }
+
+    while(dir->buffered > 0)
+    {
+        ssize_t n = ::splice(dir->pipefd[0],nullptr,dst->fd(),nullptr,dir->buffered,
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(n > 0)
+        {
+            dir->buffered -= n;
+            dir->forwarded += n;
+        }
+        else if(n < 0 && errno == EAGAIN) //dst的内核发送缓冲区满了
+        {
+            break;
+        }
+        else
+        {
+            LOG_ERROR("Relay::pump %s splice err:%d \n",dst->name().c_str(),errno);
+            close();
+            return;
+        }
+    }
+    dst->watchWritable(dir->buffered > 0);
+
+    if(!dir->eof && dir->buffered <= lowWaterMark_ && !src->isReading())
+    {
+        src->startRead();
+    }
+
+    if(dir->eof && dir->buffered == 0 && !dir->done)
+    {
+        dir->done = true;
+        dst->shutdown();
+        if(directions_[0].done && directions_[1].done)
+        {
+            close();
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+
+#include <memory>
+#include <stddef.h>
+
+class TcpConnection;
+
+/*
+L4转发: 把一条入站连接和一条出站连接配对，每个方向一个pipe，用splice(2)在内核里搬运数据
+    src socket --splice--> pipe --splice--> dst socket
+转发的数据不经过inputBuffer_/outputBuffer_，也不回调messageCallback
+
+流控: pipe里积压的数据达到高水位时停止读src(关掉EPOLLIN)，dst写到低水位以下再恢复读src；
+     dst写不动时打开它的EPOLLOUT，可写以后继续搬运
+一端读到EOF并且pipe里的数据都写出去以后，对另一端shutdownWrite(半关闭)，两个方向都结束时关闭两条连接
+
+两条连接必须属于同一个EventLoop，start()/close()只能在这个loop线程里调用
+任一条连接断开时(connectionCallback里!connected())应该调用close()关闭另一条
+*/
+class Relay : noncopyable, public std::enable_shared_from_this<Relay>
+{
+public:
+    Relay(const TcpConnectionPtr& downstream,
+        const TcpConnectionPtr& upstream,
+        size_t highWaterMark = 1024*1024,
+        size_t lowWaterMark = 256*1024);
+    ~Relay();
+
+    // 开始转发，两条连接上已经读到inputBuffer_里的数据会先拷贝发送给对方
+    void start();
+    // 关闭两条连接，可以重复调用
+    void close();
+
+    // 两个方向已经转发的字节数
+    size_t downstreamBytes() const { return directions_[0].forwarded; }
+    size_t upstreamBytes() const { return directions_[1].forwarded; }
+
+private:
+    struct Direction
+    {
+        Direction() : buffered(0),forwarded(0),eof(false),done(false) { pipefd[0] = pipefd[1] = -1; }
+
+        std::weak_ptr<TcpConnection> src;
+        std::weak_ptr<TcpConnection> dst;
+        int pipefd[2];
+        size_t buffered;   //pipe里还没写给dst的字节数
+        size_t forwarded;  //已经写给dst的字节数
+        bool eof;          //src已经读到EOF
+        bool done;         //已经对dst做了shutdownWrite
+    };
+
+    void handleReadable(Direction* dir,Timestamp receiveTime);
+    void handleWritable(Direction* dir);
+    void pump(Direction* dir,const TcpConnectionPtr& src,const TcpConnectionPtr& dst);
+
+    Direction directions_[2]; //[0]: downstream => upstream  [1]: upstream => downstream
+    size_t capacity_;         //pipe的容量
+    size_t highWaterMark_;
+    size_t lowWaterMark_;
+    bool closed_;
+};
+
+using RelayPtr = std::shared_ptr<Relay>;
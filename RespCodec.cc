@@ -0,0 +1,350 @@
+#include "RespCodec.h"
+#include "Buffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+
+// 在[begin,end)里找\r\n，返回\r的位置，没找到返回nullptr
+const char* findCrlf(const char* begin,const char* end)
+{
+    const char* p = begin;
+    while(p < end)
+    {
+        const char* cr = static_cast<const char*>(::memchr(p,'\r',end - p));
+        if(cr == nullptr || cr + 1 >= end)
+        {
+            return nullptr;
+        }
+        if(cr[1] == '\n')
+        {
+            return cr;
+        }
+        p = cr + 1;
+    }
+    return nullptr;
+}
+
+// 严格解析[begin,end)里的十进制整数，允许前导负号
+bool parseInteger(const char* begin,const char* end,int64_t* value)
+{
+    if(begin == end)
+    {
+        return false;
+    }
+    bool negative = false;
+    if(*begin == '-')
+    {
+        negative = true;
+        if(++begin == end)
+        {
+            return false;
+        }
+    }
+    if(end - begin > 18)
+    {
+        return false;
+    }
+    int64_t v = 0;
+    for(const char* p = begin;p < end;++p)
+    {
+        if(*p < '0' || *p > '9')
+        {
+            return false;
+        }
+        v = v * 10 + (*p - '0');
+    }
+    *value = negative ? -v : v;
+    return true;
+}
+
+// 解析以prefix开头、\r\n结尾的长度行，返回1/0/-1，next指向这一行之后
+int parseLengthLine(const char* p,const char* end,char prefix,int64_t* value,const char** next)
+{
+    if(p >= end)
+    {
+        return 0;
+    }
+    if(*p != prefix)
+    {
+        return -1;
+    }
+    const char* crlf = findCrlf(p + 1,end);
+    if(crlf == nullptr)
+    {
+        return end - p > 32 ? -1 : 0; //长度行不会这么长
+    }
+    if(!parseInteger(p + 1,crlf,value))
+    {
+        return -1;
+    }
+    *next = crlf + 2;
+    return 1;
+}
+
+bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+int parseInline(const char* begin,const char* end,std::vector<RespSlice>* args,size_t* consumed)
+{
+    const char* eol = static_cast<const char*>(::memchr(begin,'\n',end - begin));
+    if(eol == nullptr)
+    {
+        return static_cast<size_t>(end - begin) > RespCodec::kMaxInlineLen ? -1 : 0;
+    }
+    const char* p = begin;
+    while(p < eol)
+    {
+        while(p < eol && isBlank(*p))
+        {
+            ++p;
+        }
+        const char* word = p;
+        while(p < eol && !isBlank(*p))
+        {
+            ++p;
+        }
+        if(p > word)
+        {
+            args->push_back(RespSlice(word,p - word));
+        }
+    }
+    *consumed = eol + 1 - begin;
+    return 1;
+}
+
+// 跳过一个完整的回复，返回1/0/-1，next指向它之后
+int skipReply(const char* p,const char* end,RespReply* reply,const char** next,int depth)
+{
+    if(p >= end)
+    {
+        return 0;
+    }
+    if(depth > 32)
+    {
+        return -1;
+    }
+    const char type = *p;
+    const char* crlf = findCrlf(p + 1,end);
+    if(crlf == nullptr)
+    {
+        return 0;
+    }
+    if(reply != nullptr)
+    {
+        reply->type = type;
+        reply->integer = 0;
+        reply->str = RespSlice();
+    }
+    switch(type)
+    {
+    case '+':
+    case '-':
+        if(reply != nullptr)
+        {
+            reply->str = RespSlice(p + 1,crlf - p - 1);
+        }
+        *next = crlf + 2;
+        return 1;
+    case ':':
+    {
+        int64_t value;
+        if(!parseInteger(p + 1,crlf,&value))
+        {
+            return -1;
+        }
+        if(reply != nullptr)
+        {
+            reply->integer = value;
+        }
+        *next = crlf + 2;
+        return 1;
+    }
+    case '$':
+    {
+        int64_t len;
+        if(!parseInteger(p + 1,crlf,&len) || len < -1 || len > static_cast<int64_t>(RespCodec::kMaxBulkLen))
+        {
+            return -1;
+        }
+        const char* body = crlf + 2;
+        if(len >= 0)
+        {
+            if(end - body < len + 2)
+            {
+                return 0;
+            }
+            if(body[len] != '\r' || body[len + 1] != '\n')
+            {
+                return -1;
+            }
+            *next = body + len + 2;
+        }
+        else
+        {
+            *next = body;
+        }
+        if(reply != nullptr)
+        {
+            reply->integer = len;
+            if(len >= 0)
+            {
+                reply->str = RespSlice(body,len);
+            }
+        }
+        return 1;
+    }
+    case '*':
+    {
+        int64_t count;
+        if(!parseInteger(p + 1,crlf,&count) || count < -1 || count > RespCodec::kMaxArgs)
+        {
+            return -1;
+        }
+        if(reply != nullptr)
+        {
+            reply->integer = count;
+        }
+        const char* q = crlf + 2;
+        for(int64_t i=0;i<count;i++)
+        {
+            int ret = skipReply(q,end,nullptr,&q,depth + 1);
+            if(ret <= 0)
+            {
+                return ret;
+            }
+        }
+        *next = q;
+        return 1;
+    }
+    default:
+        return -1;
+    }
+}
+
+} // namespace
+
+bool RespSlice::equalsIgnoreCase(const char* s) const
+{
+    size_t n = ::strlen(s);
+    return n == len && ::strncasecmp(data,s,n) == 0;
+}
+
+int RespCodec::parseCommand(const Buffer* buf,std::vector<RespSlice>* args,size_t* consumed)
+{
+    args->clear();
+    const char* begin = buf->peek();
+    const char* end = begin + buf->readableBytes();
+    if(begin == end)
+    {
+        return 0;
+    }
+    if(*begin != '*')
+    {
+        return parseInline(begin,end,args,consumed);
+    }
+
+    int64_t count;
+    const char* p;
+    int ret = parseLengthLine(begin,end,'*',&count,&p);
+    if(ret <= 0)
+    {
+        return ret;
+    }
+    if(count > kMaxArgs)
+    {
+        return -1;
+    }
+    for(int64_t i=0;i<count;i++)
+    {
+        int64_t len;
+        ret = parseLengthLine(p,end,'$',&len,&p);
+        if(ret <= 0)
+        {
+            return ret;
+        }
+        if(len < 0 || len > static_cast<int64_t>(kMaxBulkLen))
+        {
+            return -1;
+        }
+        if(end - p < len + 2)
+        {
+            return 0; //批量字符串还没收全，不扫描它的内容
+        }
+        if(p[len] != '\r' || p[len + 1] != '\n')
+        {
+            return -1;
+        }
+        args->push_back(RespSlice(p,len));
+        p += len + 2;
+    }
+    *consumed = p - begin;
+    return 1;
+}
+
+int RespCodec::parseReply(const Buffer* buf,RespReply* reply,size_t* consumed)
+{
+    const char* begin = buf->peek();
+    const char* next = begin;
+    int ret = skipReply(begin,begin + buf->readableBytes(),reply,&next,0);
+    if(ret > 0)
+    {
+        *consumed = next - begin;
+    }
+    return ret;
+}
+
+void RespCodec::appendSimpleString(Buffer* buf,const char* str)
+{
+    buf->append("+",1);
+    buf->append(str,::strlen(str));
+    buf->append("\r\n",2);
+}
+
+void RespCodec::appendError(Buffer* buf,const char* message)
+{
+    buf->append("-",1);
+    buf->append(message,::strlen(message));
+    buf->append("\r\n",2);
+}
+
+void RespCodec::appendInteger(Buffer* buf,int64_t value)
+{
+    char line[32];
+    int n = ::snprintf(line,sizeof line,":%lld\r\n",static_cast<long long>(value));
+    buf->append(line,n);
+}
+
+void RespCodec::appendBulkString(Buffer* buf,const char* data,size_t len)
+{
+    char line[32];
+    int n = ::snprintf(line,sizeof line,"$%zu\r\n",len);
+    buf->append(line,n);
+    buf->append(data,len);
+    buf->append("\r\n",2);
+}
+
+void RespCodec::appendNullBulkString(Buffer* buf)
+{
+    buf->append("$-1\r\n",5);
+}
+
+void RespCodec::appendArrayHeader(Buffer* buf,size_t count)
+{
+    char line[32];
+    int n = ::snprintf(line,sizeof line,"*%zu\r\n",count);
+    buf->append(line,n);
+}
+
+void RespCodec::appendCommand(Buffer* buf,const std::vector<RespSlice>& args)
+{
+    appendArrayHeader(buf,args.size());
+    for(const RespSlice& arg : args)
+    {
+        appendBulkString(buf,arg.data,arg.len);
+    }
+}
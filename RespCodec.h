@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class Buffer;
+
+// 指向Buffer里的一段数据，不拷贝；Buffer被retrieve之前有效
+struct RespSlice
+{
+    RespSlice() : data(nullptr),len(0) {}
+    RespSlice(const char* d,size_t n) : data(d),len(n) {}
+
+    std::string toString() const { return std::string(data,len); }
+    // 和C字符串按ASCII不区分大小写比较，用来匹配命令名
+    bool equalsIgnoreCase(const char* s) const;
+
+    const char* data;
+    size_t len;
+};
+
+// 一个回复的顶层信息，type是RESP的类型字节: + - : $ *
+struct RespReply
+{
+    char type;
+    RespSlice str;      //简单字符串、错误、批量字符串的内容；空批量字符串时data为nullptr
+    int64_t integer;    //整数，或者批量字符串/数组的长度(-1表示空)
+};
+
+/*
+RESP2(Redis协议)的解析和序列化，直接在Buffer上操作
+
+服务端用parseCommand从Buffer开头一条一条地解命令，流水线发来的多条命令循环调用即可；
+多批量格式(*N\r\n$len\r\n...)的参数直接指向Buffer里的数据，不拷贝，大的批量字符串只跳过不扫描；
+也支持redis-cli/telnet的行内命令，按空白分割，不支持引号
+客户端用parseReply解一个完整的回复(嵌套的数组整体跳过)
+序列化函数把回复或命令追加到Buffer末尾，攒够一批再发
+*/
+class RespCodec
+{
+public:
+    static const size_t kMaxBulkLen = 512 * 1024 * 1024;
+    static const int64_t kMaxArgs = 1024 * 1024;
+    static const size_t kMaxInlineLen = 64 * 1024;
+
+    // 返回1表示解出一条命令，args是它的参数(可能为空，比如空行)，consumed是这条命令的字节数；
+    // 0表示数据还不够；-1表示协议错误，连接应当关闭
+    static int parseCommand(const Buffer* buf,std::vector<RespSlice>* args,size_t* consumed);
+    // 和parseCommand一样的返回值
+    static int parseReply(const Buffer* buf,RespReply* reply,size_t* consumed);
+
+    static void appendSimpleString(Buffer* buf,const char* str);
+    static void appendError(Buffer* buf,const char* message);
+    static void appendInteger(Buffer* buf,int64_t value);
+    static void appendBulkString(Buffer* buf,const char* data,size_t len);
+    static void appendBulkString(Buffer* buf,const std::string& str) { appendBulkString(buf,str.data(),str.size()); }
+    static void appendNullBulkString(Buffer* buf);
+    static void appendArrayHeader(Buffer* buf,size_t count);
+    // 客户端: 把参数编码成一条多批量格式的命令
+    static void appendCommand(Buffer* buf,const std::vector<RespSlice>& args);
+};
@@ -0,0 +1,158 @@
+#include "RpcClient.h"
+#include "EventLoop.h"
+#include "Clock.h"
+#include "Logger.h"
+
+const double RpcClient::kTimeoutCheckInterval = 0.01;
+
+RpcClient::RpcClient(EventLoop* loop,const InetAddress& serverAddr,const std::string& nameArg)
+    :loop_(loop)
+    ,client_(loop,serverAddr,nameArg)
+{
+    client_.setConnectionCallback(std::bind(&RpcClient::onConnection,this,std::placeholders::_1));
+    client_.setMessageCallback(std::bind(&RpcClient::onMessage,this,
+        std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+    //同一轮里发出的多个请求合并成一次写
+    client_.setCorkedWrites(true);
+    timeoutTimer_ = loop_->runEvery(kTimeoutCheckInterval,std::bind(&RpcClient::checkTimeouts,this));
+}
+
+RpcClient::~RpcClient()
+{
+    loop_->cancel(timeoutTimer_);
+    if(conn_)
+    {
+        //连接会比RpcClient活得久，它的回调不能再指向this；未完成的调用直接丢弃，不再回调
+        conn_->setConnectionCallback(ConnectionCallback());
+        conn_->setMessageCallback([](const TcpConnectionPtr&,Buffer* buf,Timestamp) { buf->retrieveAll(); });
+    }
+}
+
+void RpcClient::call(uint16_t method,const std::string& request,const RpcCallback& cb,double timeoutSeconds)
+{
+    if(loop_->isInLoopThread())
+    {
+        startCall(method,request.data(),request.size(),cb,timeoutSeconds);
+    }
+    else
+    {
+        loop_->queueInLoop(std::bind(&RpcClient::callInLoop,this,method,request,cb,timeoutSeconds));
+    }
+}
+
+void RpcClient::call(uint16_t method,const char* data,size_t len,const RpcCallback& cb,double timeoutSeconds)
+{
+    if(loop_->isInLoopThread())
+    {
+        startCall(method,data,len,cb,timeoutSeconds);
+    }
+    else
+    {
+        loop_->queueInLoop(std::bind(&RpcClient::callInLoop,this,method,std::string(data,len),cb,timeoutSeconds));
+    }
+}
+
+void RpcClient::callInLoop(uint16_t method,const std::string& request,const RpcCallback& cb,double timeoutSeconds)
+{
+    startCall(method,request.data(),request.size(),cb,timeoutSeconds);
+}
+
+void RpcClient::startCall(uint16_t method,const char* data,size_t len,const RpcCallback& cb,double timeoutSeconds)
+{
+    if(!conn_ || !conn_->connected())
+    {
+        cb(kRpcDisconnected,nullptr,0);
+        return;
+    }
+    PendingCall call;
+    call.cb = cb;
+    uint64_t id = pending_.insert(std::move(call));
+    if(timeoutSeconds > 0)
+    {
+        deadlines_.push(Deadline(Clock::nowNs() + static_cast<int64_t>(timeoutSeconds * 1e9),id));
+    }
+    RpcCodec::send(conn_,id,RpcCodec::kRequest,method,data,len);
+}
+
+// 先把调用从表里拿掉再回调，回调里发起的新调用可以复用这个槽位
+void RpcClient::complete(uint64_t id,RpcStatus status,const char* data,size_t len)
+{
+    PendingCall* call = pending_.find(id);
+    if(call == nullptr)
+    {
+        return; //已经超时，或者id不认识
+    }
+    RpcCallback cb(std::move(call->cb));
+    pending_.erase(id);
+    cb(status,data,len);
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        conn_ = conn;
+    }
+    else
+    {
+        conn_.reset();
+        failAll(kRpcDisconnected);
+    }
+    if(connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+void RpcClient::onMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp /*receiveTime*/)
+{
+    RpcFrame frame;
+    size_t frameLen = 0;
+    int ret;
+    while((ret = RpcCodec::decode(buf,&frame,&frameLen)) > 0)
+    {
+        if(frame.kind != RpcCodec::kResponse)
+        {
+            ret = -1;
+            break;
+        }
+        complete(frame.id,static_cast<RpcStatus>(frame.code),frame.body,frame.bodyLen);
+        buf->retrieve(frameLen);
+    }
+    if(ret < 0)
+    {
+        LOG_ERROR("RpcClient::onMessage [%s] bad frame, close connection \n",conn->name().c_str());
+        buf->retrieveAll();
+        conn->forceClose();
+    }
+}
+
+void RpcClient::checkTimeouts()
+{
+    if(deadlines_.empty())
+    {
+        return;
+    }
+    const int64_t now = Clock::nowNs();
+    while(!deadlines_.empty() && deadlines_.top().first <= now)
+    {
+        uint64_t id = deadlines_.top().second;
+        deadlines_.pop();
+        complete(id,kRpcTimeout,nullptr,0);
+    }
+}
+
+void RpcClient::failAll(RpcStatus status)
+{
+    std::vector<RpcCallback> callbacks;
+    pending_.forEach([&callbacks](PendingCall& call) { callbacks.push_back(std::move(call.cb)); });
+    pending_.clear();
+    while(!deadlines_.empty())
+    {
+        deadlines_.pop();
+    }
+    for(RpcCallback& cb : callbacks)
+    {
+        cb(status,nullptr,0);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpClient.h"
+#include "RpcCodec.h"
+#include "SlotTable.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 调用结果，status不是kRpcOk时没有响应体；data只在回调期间有效
+using RpcCallback = std::function<void(RpcStatus status,const char* data,size_t len)>;
+
+/*
+RPC客户端: 一条连接上同时有任意多个未完成的调用，按请求id对应响应，响应可以乱序
+未完成的调用放在SlotTable里，请求id就是槽位id，不用哈希也不为每次调用分配节点
+每个调用可以有自己的超时，超时检查每kTimeoutCheckInterval秒做一次；连接断开时所有未完成的调用以kRpcDisconnected结束
+回调都在loop线程里执行；RpcClient要在loop线程里析构，这时还没完成的调用不再回调
+*/
+class RpcClient : noncopyable
+{
+public:
+    static const double kTimeoutCheckInterval;
+
+    RpcClient(EventLoop* loop,const InetAddress& serverAddr,const std::string& nameArg);
+    ~RpcClient();
+
+    void connect() { client_.connect(); }
+    void disconnect() { client_.disconnect(); }
+    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    TcpClient* client() { return &client_; }
+
+    // 可以跨线程调用；timeoutSeconds<=0表示不限时；没有连接时直接以kRpcDisconnected回调
+    void call(uint16_t method,const std::string& request,const RpcCallback& cb,double timeoutSeconds = 0);
+    // 在loop线程里调用时请求体不拷贝
+    void call(uint16_t method,const char* data,size_t len,const RpcCallback& cb,double timeoutSeconds = 0);
+
+    // 未完成的调用个数，只能在loop线程里调用
+    size_t outstanding() const { return pending_.size(); }
+
+private:
+    struct PendingCall
+    {
+        RpcCallback cb;
+    };
+    using Deadline = std::pair<int64_t,uint64_t>; //(超时时刻,请求id)
+
+    void callInLoop(uint16_t method,const std::string& request,const RpcCallback& cb,double timeoutSeconds);
+    void startCall(uint16_t method,const char* data,size_t len,const RpcCallback& cb,double timeoutSeconds);
+    void complete(uint64_t id,RpcStatus status,const char* data,size_t len);
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime);
+    void checkTimeouts();
+    void failAll(RpcStatus status);
+
+    EventLoop* loop_;
+    TcpClient client_;
+    ConnectionCallback connectionCallback_;
+    TcpConnectionPtr conn_;         //只在loop线程里访问
+    SlotTable<PendingCall> pending_;
+    // 最早超时的在堆顶；调用已经完成的条目留在堆里，到期弹出时发现id已经失效就跳过
+    std::priority_queue<Deadline,std::vector<Deadline>,std::greater<Deadline>> deadlines_;
+    TimerId timeoutTimer_;
+};
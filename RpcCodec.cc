@@ -0,0 +1,72 @@
+#include "RpcCodec.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+
+#include <endian.h>
+#include <string.h>
+
+void RpcCodec::encodeHeader(char* header,uint64_t id,uint8_t kind,uint16_t code,size_t bodyLen)
+{
+    uint32_t length = htobe32(static_cast<uint32_t>(kHeaderLen - 4 + bodyLen));
+    uint64_t beId = htobe64(id);
+    uint16_t beCode = htobe16(code);
+    ::memcpy(header,&length,4);
+    ::memcpy(header + 4,&beId,8);
+    header[12] = static_cast<char>(kind);
+    ::memcpy(header + 13,&beCode,2);
+}
+
+int RpcCodec::decode(const Buffer* buf,RpcFrame* frame,size_t* frameLen)
+{
+    const size_t readable = buf->readableBytes();
+    if(readable < 4)
+    {
+        return 0;
+    }
+    const char* data = buf->peek();
+    uint32_t length;
+    ::memcpy(&length,data,4);
+    length = be32toh(length);
+    if(length < kHeaderLen - 4 || length > kMaxFrameLen)
+    {
+        return -1;
+    }
+    if(readable < 4 + static_cast<size_t>(length))
+    {
+        return 0;
+    }
+    uint64_t id;
+    uint16_t code;
+    ::memcpy(&id,data + 4,8);
+    ::memcpy(&code,data + 13,2);
+    frame->id = be64toh(id);
+    frame->kind = static_cast<uint8_t>(data[12]);
+    frame->code = be16toh(code);
+    frame->body = data + kHeaderLen;
+    frame->bodyLen = length - (kHeaderLen - 4);
+    *frameLen = 4 + length;
+    return 1;
+}
+
+void RpcCodec::send(const TcpConnectionPtr& conn,uint64_t id,uint8_t kind,uint16_t code,const char* body,size_t len)
+{
+    char header[kHeaderLen];
+    encodeHeader(header,id,kind,code,len);
+    if(conn->getLoop()->isInLoopThread())
+    {
+        conn->send(header,kHeaderLen);
+        if(len > 0)
+        {
+            conn->send(body,len);
+        }
+    }
+    else
+    {
+        std::string frame;
+        frame.reserve(kHeaderLen + len);
+        frame.append(header,kHeaderLen);
+        frame.append(body,len);
+        conn->send(frame);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Callbacks.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Buffer;
+
+// 响应帧里的状态码，kRpcTimeout和kRpcDisconnected只在客户端本地产生
+enum RpcStatus
+{
+    kRpcOk = 0,
+    kRpcNoSuchMethod = 1,
+    kRpcError = 2,         //服务端处理失败
+    kRpcTimeout = 3,
+    kRpcDisconnected = 4,
+};
+
+// 解出来的一帧，body直接指向Buffer里的数据，retrieve之前有效
+struct RpcFrame
+{
+    uint64_t id;
+    uint8_t kind;
+    uint16_t code;
+    const char* body;
+    size_t bodyLen;
+};
+
+/*
+长度前缀的RPC帧，整数都是网络字节序:
+
+    | length:4 | id:8 | kind:1 | code:2 | body |
+
+length是它后面的字节数；请求的code是方法号，响应的code是RpcStatus
+id由客户端分配，响应带回同一个id，同一个连接上可以有很多个未完成的调用，响应可以乱序返回
+*/
+class RpcCodec
+{
+public:
+    static const size_t kHeaderLen = 15;
+    static const size_t kMaxFrameLen = 64 * 1024 * 1024;
+
+    enum Kind
+    {
+        kRequest = 0,
+        kResponse = 1,
+    };
+
+    static void encodeHeader(char* header,uint64_t id,uint8_t kind,uint16_t code,size_t bodyLen);
+
+    // 返回1表示解出一帧，frameLen是整帧的长度；0表示数据还不够；-1表示帧长度非法
+    static int decode(const Buffer* buf,RpcFrame* frame,size_t* frameLen);
+
+    // 在conn的loop线程里分两次send(连接应当打开corked模式，合并成一次写)，
+    // 跨线程时拼成一个字符串发送，保证帧不会和别的线程发的帧交错
+    static void send(const TcpConnectionPtr& conn,uint64_t id,uint8_t kind,uint16_t code,const char* body,size_t len);
+};
@@ -0,0 +1,49 @@
+#include "RpcServer.h"
+#include "Logger.h"
+
+RpcServer::RpcServer(EventLoop* loop,const InetAddress& listenAddr,const std::string& nameArg)
+    :server_(loop,listenAddr,nameArg)
+{
+    server_.setMessageCallback(std::bind(&RpcServer::onMessage,this,
+        std::placeholders::_1,std::placeholders::_2,std::placeholders::_3));
+    server_.setCorkedWrites(true);
+}
+
+void RpcServer::registerMethod(uint16_t method,const RpcHandler& handler)
+{
+    if(method >= methods_.size())
+    {
+        methods_.resize(method + 1);
+    }
+    methods_[method] = handler;
+}
+
+void RpcServer::onMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp /*receiveTime*/)
+{
+    RpcFrame frame;
+    size_t frameLen = 0;
+    int ret;
+    while((ret = RpcCodec::decode(buf,&frame,&frameLen)) > 0)
+    {
+        if(frame.kind != RpcCodec::kRequest)
+        {
+            ret = -1;
+            break;
+        }
+        if(frame.code < methods_.size() && methods_[frame.code])
+        {
+            methods_[frame.code](RpcCall(conn,frame.id,frame.code,frame.body,frame.bodyLen));
+        }
+        else
+        {
+            RpcCodec::send(conn,frame.id,RpcCodec::kResponse,kRpcNoSuchMethod,nullptr,0);
+        }
+        buf->retrieve(frameLen);
+    }
+    if(ret < 0)
+    {
+        LOG_ERROR("RpcServer::onMessage [%s] bad frame, close connection \n",conn->name().c_str());
+        buf->retrieveAll();
+        conn->forceClose();
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "RpcCodec.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+一次调用: 请求体和回复句柄
+data()只在handler返回之前有效；要异步回复(比如交给ComputePool)时把RpcCall拷贝走，
+它持有连接，可以在任意线程里reply，回复可以和其它调用乱序
+*/
+class RpcCall
+{
+public:
+    RpcCall(const TcpConnectionPtr& conn,uint64_t id,uint16_t method,const char* data,size_t len)
+        :conn_(conn),id_(id),method_(method),data_(data),len_(len)
+    {}
+
+    uint64_t id() const { return id_; }
+    uint16_t method() const { return method_; }
+    const char* data() const { return data_; }
+    size_t size() const { return len_; }
+    const TcpConnectionPtr& connection() const { return conn_; }
+
+    void reply(const char* data,size_t len) const
+    { RpcCodec::send(conn_,id_,RpcCodec::kResponse,kRpcOk,data,len); }
+    void reply(const std::string& body) const { reply(body.data(),body.size()); }
+    void fail(uint16_t status = kRpcError) const
+    { RpcCodec::send(conn_,id_,RpcCodec::kResponse,status,nullptr,0); }
+
+private:
+    TcpConnectionPtr conn_;
+    uint64_t id_;
+    uint16_t method_;
+    const char* data_;
+    size_t len_;
+};
+
+using RpcHandler = std::function<void(const RpcCall&)>;
+
+/*
+RPC服务端: 在TcpServer上解RpcCodec帧，按方法号查表分发
+方法表是按方法号下标的数组，分发一次调用只有一次数组访问和一次std::function调用，没有查找和内存分配
+连接打开corked模式，一轮事件里的多个回复合并成一次写
+*/
+class RpcServer : noncopyable
+{
+public:
+    RpcServer(EventLoop* loop,const InetAddress& listenAddr,const std::string& nameArg);
+
+    // 必须在start()之前注册
+    void registerMethod(uint16_t method,const RpcHandler& handler);
+
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    // 其它连接配置(限速、准入控制等)直接设置在底层的TcpServer上
+    TcpServer* server() { return &server_; }
+
+    void start() { server_.start(); }
+
+private:
+    void onMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime);
+
+    TcpServer server_;
+    std::vector<RpcHandler> methods_;
+};
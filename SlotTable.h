@@ -0,0 +1,136 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/*
+带代数(generation)的扁平槽位表，用64位整数id代替字符串作为key
+
+    id = | shard(16bit) | generation(16bit) | index(32bit) |
+
+index是slots_数组的下标，查找/删除都是O(1)，没有哈希和节点分配
+槽位被释放时generation加1，旧id再来查找时generation对不上，不会误命中新对象
+shard用来区分多个表(比如每个subloop一张表)，保证不同表分配出的id全局唯一
+*/
+template <typename T>
+class SlotTable : noncopyable
+{
+public:
+    using Id = uint64_t;
+
+    explicit SlotTable(uint16_t shard = 0)
+        : shard_(shard)
+        , size_(0)
+    {}
+
+    static uint16_t shardOf(Id id) { return static_cast<uint16_t>(id >> 48); }
+
+    // 放入value，返回它的id，id永远不为0
+    Id insert(T value)
+    {
+        uint32_t index;
+        if (!freeList_.empty())
+        {
+            index = freeList_.back();
+            freeList_.pop_back();
+        }
+        else
+        {
+            index = static_cast<uint32_t>(slots_.size());
+            slots_.push_back(Slot());
+        }
+        Slot &slot = slots_[index];
+        slot.used = true;
+        slot.value = std::move(value);
+        ++size_;
+        return makeId(slot.generation, index);
+    }
+
+    // id失效(已经被删除或者不属于本表)时返回nullptr
+    T *find(Id id)
+    {
+        Slot *slot = lookup(id);
+        return slot ? &slot->value : nullptr;
+    }
+
+    bool erase(Id id)
+    {
+        Slot *slot = lookup(id);
+        if (slot == nullptr)
+        {
+            return false;
+        }
+        slot->value = T();
+        slot->used = false;
+        if (++slot->generation == 0) // 0保留给无效id
+        {
+            slot->generation = 1;
+        }
+        freeList_.push_back(indexOf(id));
+        --size_;
+        return true;
+    }
+
+    template <typename Func>
+    void forEach(Func func)
+    {
+        for (Slot &slot : slots_)
+        {
+            if (slot.used)
+            {
+                func(slot.value);
+            }
+        }
+    }
+
+    void clear()
+    {
+        slots_.clear();
+        freeList_.clear();
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    struct Slot
+    {
+        Slot() : generation(1), used(false), value() {}
+
+        uint16_t generation;
+        bool used;
+        T value;
+    };
+
+    static uint32_t indexOf(Id id) { return static_cast<uint32_t>(id); }
+    static uint16_t generationOf(Id id) { return static_cast<uint16_t>(id >> 32); }
+
+    Id makeId(uint16_t generation, uint32_t index) const
+    {
+        return (static_cast<Id>(shard_) << 48) | (static_cast<Id>(generation) << 32) | index;
+    }
+
+    Slot *lookup(Id id)
+    {
+        uint32_t index = indexOf(id);
+        if (shardOf(id) != shard_ || index >= slots_.size())
+        {
+            return nullptr;
+        }
+        Slot &slot = slots_[index];
+        if (!slot.used || slot.generation != generationOf(id))
+        {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    const uint16_t shard_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeList_; // 空闲槽位，后进先出，优先复用刚释放的热槽位
+    size_t size_;
+};
@@ -8,6 +8,10 @@
 #include <strings.h>
 #include <netinet/tcp.h>
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
 Socket::~Socket()
 {
     ::close(sockfd_);
@@ -15,7 +19,7 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress &localaddr)
 {
-    if (0 != ::bind(sockfd_, (sockaddr*)localaddr.getSockAddr(), sizeof(sockaddr_in)))
+    if (0 != ::bind(sockfd_, localaddr.getSockAddr(), localaddr.getSockLen()))
     {
         LOG_FATAL("bind sockfd:%d fail \n", sockfd_);
     }
@@ -36,13 +40,13 @@ poller + non-blocking IO
 */
 int Socket::accept(InetAddress *peeraddr)
 {
-    sockaddr_in addr;
+    sockaddr_storage addr;
     socklen_t len = sizeof addr;
     bzero(&addr,sizeof(addr));
     int connfd = ::accept4(sockfd_,(sockaddr*)&addr,&len,SOCK_NONBLOCK | SOCK_CLOEXEC);
     if(connfd >= 0)
     {
-        peeraddr->setSockAddr(addr);
+        peeraddr->setSockAddr((sockaddr*)&addr,len);
     }
     return connfd;
 }
@@ -61,6 +65,20 @@ void Socket::setTcpNoDelay(bool on)
                 &optval,sizeof optval);
 }
 
+void Socket::setTcpCork(bool on)
+{
+    int optval = on?1:0;
+    ::setsockopt(sockfd_,IPPROTO_TCP,TCP_CORK,
+                &optval,sizeof optval);
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on?1:0;
+    return ::setsockopt(sockfd_,SOL_SOCKET,SO_ZEROCOPY,
+                &optval,sizeof optval) == 0;
+}
+
 void Socket::setReuseAddr(bool on)
 {
     int optval = on?1:0;
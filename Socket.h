@@ -21,9 +21,12 @@ public:
 
     void shutdownWrite();
     void setTcpNoDelay(bool on);
+    void setTcpCork(bool on);
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    // 打开SO_ZEROCOPY，内核或者协议族不支持时返回false
+    bool setZeroCopy(bool on);
 private:
     const int sockfd_;
 };
\ No newline at end of file
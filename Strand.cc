@@ -0,0 +1,99 @@
+#include "Strand.h"
+#include "ComputePool.h"
+#include "EventLoop.h"
+
+// 当前线程正在执行的Strand
+static thread_local const Strand* t_currentStrand = nullptr;
+
+StrandPtr Strand::create(ComputePool* pool)
+{
+    return std::make_shared<Strand>([pool](Task task) { pool->run(std::move(task)); });
+}
+
+StrandPtr Strand::create(EventLoop* loop)
+{
+    return std::make_shared<Strand>([loop](Task task) { loop->queueInLoop(std::move(task)); });
+}
+
+StrandPtr Strand::create(const Executor& executor)
+{
+    return std::make_shared<Strand>(executor);
+}
+
+Strand::Strand(const Executor& executor)
+    :executor_(executor)
+    ,scheduled_(false)
+{
+}
+
+Strand::~Strand()
+{
+}
+
+void Strand::post(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+        if(scheduled_)
+        {
+            return; //正在drain的那次会执行到它
+        }
+        scheduled_ = true;
+    }
+    executor_(std::bind(&Strand::drain,shared_from_this()));
+}
+
+void Strand::dispatch(Task task)
+{
+    if(runningInThisThread())
+    {
+        task();
+    }
+    else
+    {
+        post(std::move(task));
+    }
+}
+
+bool Strand::runningInThisThread() const
+{
+    return t_currentStrand == this;
+}
+
+void Strand::drain()
+{
+    const Strand* saved = t_currentStrand; //执行器可能在别的Strand的任务里同步调用drain
+    t_currentStrand = this;
+    for(int i=0;i<kMaxBatch;i++)
+    {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(tasks_.empty())
+            {
+                scheduled_ = false;
+                t_currentStrand = saved;
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+    t_currentStrand = saved;
+    //还有任务，让出执行器，scheduled_保持为true，后来的post不会再重复安排
+    executor_(std::bind(&Strand::drain,shared_from_this()));
+}
+
+StrandGroup::StrandGroup(ComputePool* pool,size_t numStrands)
+{
+    if(numStrands == 0)
+    {
+        numStrands = 1;
+    }
+    for(size_t i=0;i<numStrands;i++)
+    {
+        strands_.push_back(Strand::create(pool));
+    }
+}
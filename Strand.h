@@ -0,0 +1,74 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class EventLoop;
+class ComputePool;
+class Strand;
+
+using StrandPtr = std::shared_ptr<Strand>;
+
+/*
+串行执行器(strand): 投递到同一个Strand的任务按投递顺序一个接一个执行，不会并发，
+不同的Strand之间照常并行，同一个key上的处理不再需要应用自己加锁
+
+Strand自己不占线程，有任务时把一次drain交给底层的执行器(ComputePool或者EventLoop::queueInLoop)，
+drain一次最多执行kMaxBatch个任务，剩下的重新排队，避免一个忙的Strand一直占着计算线程
+任务执行期间Strand被drain持有，投递者不用自己保证它的生命周期
+*/
+class Strand : noncopyable, public std::enable_shared_from_this<Strand>
+{
+public:
+    using Task = std::function<void()>;
+    using Executor = std::function<void(Task)>;
+
+    static const int kMaxBatch = 64;
+
+    static StrandPtr create(ComputePool* pool);
+    static StrandPtr create(EventLoop* loop);
+    static StrandPtr create(const Executor& executor);
+
+    explicit Strand(const Executor& executor);
+    ~Strand();
+
+    // 排到队尾，可以跨线程调用
+    void post(Task task);
+    // 当前就在这个Strand的任务里时直接执行，否则post
+    void dispatch(Task task);
+    bool runningInThisThread() const;
+
+private:
+    void drain();
+
+    Executor executor_;
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+    bool scheduled_; //已经有一次drain交给了执行器，还没结束
+};
+
+/*
+按key分到固定个数的Strand上: 同一个key总是落到同一个Strand，保证顺序；
+不同的key大多落在不同的Strand上并行，key很多时不用为每个key维护一个Strand
+*/
+class StrandGroup : noncopyable
+{
+public:
+    StrandGroup(ComputePool* pool,size_t numStrands);
+
+    const StrandPtr& strandOf(uint64_t key) const { return strands_[key % strands_.size()]; }
+    const StrandPtr& strandOf(const std::string& key) const { return strandOf(std::hash<std::string>()(key)); }
+
+    void post(uint64_t key,Strand::Task task) { strandOf(key)->post(std::move(task)); }
+    void post(const std::string& key,Strand::Task task) { strandOf(key)->post(std::move(task)); }
+
+private:
+    std::vector<StrandPtr> strands_;
+};
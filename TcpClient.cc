@@ -0,0 +1,161 @@
+#include "TcpClient.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "ConnectionPool.h"
+#include "Logger.h"
+
+#include <functional>
+#include <strings.h>
+#include <sys/socket.h>
+
+static EventLoop* CheckLoopNotNull(EventLoop *loop)
+{
+    if(loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d TcpClient loop is null! \n",__FILE__,__FUNCTION__,__LINE__);
+    }
+    return loop;
+}
+
+// TcpClient析构以后，残留的连接关闭时走这里
+static void removeDetachedConnection(EventLoop* loop,const TcpConnectionPtr& conn)
+{
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed,conn));
+}
+
+TcpClient::TcpClient(EventLoop* loop,
+    const InetAddress& serverAddr,
+    const std::string& nameArg)
+    :loop_(CheckLoopNotNull(loop))
+    ,connector_(new Connector(loop,serverAddr))
+    ,name_(nameArg)
+    ,namePrefix_(std::make_shared<const std::string>(nameArg+"-"+serverAddr.toIpPort()))
+    ,tcpWritePolicy_(kTcpNoDelay)
+    ,corkedWrites_(false)
+    ,retry_(false)
+    ,connect_(true)
+    ,nextConnId_(1)
+{
+    connector_->setNewConnectionCallback(
+        std::bind(&TcpClient::newConnection,this,std::placeholders::_1));
+}
+
+TcpClient::~TcpClient()
+{
+    TcpConnectionPtr conn;
+    bool unique = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unique = connection_.use_count() == 1;
+        conn = connection_;
+    }
+    if(conn)
+    {
+        //连接比TcpClient活得久，关闭回调不能再指向this
+        EventLoop* loop = loop_;
+        loop->runInLoop([loop,conn]()
+        {
+            conn->setCloseCallback(std::bind(&removeDetachedConnection,loop,std::placeholders::_1));
+        });
+        if(unique)
+        {
+            conn->forceClose();
+        }
+    }
+    else
+    {
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO("TcpClient::connect[%s] - connecting to %s \n",
+        name_.c_str(),connector_->serverAddress().toIpPort().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+    struct sockaddr_storage local,peer;
+    socklen_t localLen = sizeof local;
+    socklen_t peerLen = sizeof peer;
+    bzero(&local,sizeof local);
+    bzero(&peer,sizeof peer);
+    if(::getsockname(sockfd,(sockaddr*)&local,&localLen) < 0)
+    {
+        LOG_ERROR("sockets::getLocalAddr");
+    }
+    if(::getpeername(sockfd,(sockaddr*)&peer,&peerLen) < 0)
+    {
+        LOG_ERROR("sockets::getPeerAddr");
+    }
+    InetAddress localAddr((sockaddr*)&local,localLen);
+    InetAddress peerAddr((sockaddr*)&peer,peerLen);
+
+    TcpConnectionPtr conn(loop_->connectionPool()->create(loop_,nextConnId_++,namePrefix_,sockfd,localAddr,peerAddr));
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCorked(corkedWrites_);
+    sa_family_t family = localAddr.family();
+    if(family == AF_INET || family == AF_INET6)
+    {
+        if(tcpWritePolicy_ == kTcpNoDelay)
+        {
+            conn->setTcpNoDelay(true);
+        }
+        else if(tcpWritePolicy_ == kTcpCork)
+        {
+            conn->setTcpNoDelay(true);
+            conn->setTcpCork(true);
+        }
+    }
+    if(tlsContext_)
+    {
+        conn->startTls(tlsContext_);
+    }
+    if(capture_)
+    {
+        conn->setTrafficCapture(capture_);
+    }
+    conn->setCloseCallback(
+        std::bind(&TcpClient::removeConnection,this,std::placeholders::_1));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr& conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_.reset();
+    }
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed,conn));
+    if(retry_ && connect_)
+    {
+        LOG_INFO("TcpClient::removeConnection[%s] - reconnecting to %s \n",
+            name_.c_str(),connector_->serverAddress().toIpPort().c_str());
+        connector_->restart();
+    }
+}
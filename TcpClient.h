@@ -0,0 +1,81 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "TcpConnection.h"
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+class Connector;
+class EventLoop;
+
+using ConnectorPtr = std::shared_ptr<Connector>;
+
+/*
+对外的客户端编程使用的类，一个TcpClient管理一条到serverAddr的连接
+连接建立以后和TcpServer的连接一样，TcpConnection运行在loop线程里
+*/
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop* loop,
+            const InetAddress& serverAddr,
+            const std::string& nameArg);
+    ~TcpClient();
+
+    void connect();
+    void disconnect();
+    void stop();
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    // 连接断开后是否自动重连
+    void enableRetry() { retry_ = true; }
+    bool retry() const { return retry_; }
+
+    void setConnectionCallback(const ConnectionCallback& cb)
+    { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback& cb)
+    { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback& cb)
+    { writeCompleteCallback_ = cb; }
+    void setTcpWritePolicy(TcpWritePolicy policy) { tcpWritePolicy_ = policy; }
+    // 连接是否使用corked模式合并写，见TcpConnection::setCorked
+    void setCorkedWrites(bool on) { corkedWrites_ = on; }
+    // 连接建立后启用TLS，由客户端发起握手
+    void setTlsContext(const TlsContextPtr& ctx) { tlsContext_ = ctx; }
+    // 之后建立的连接的流量记进capture，见TrafficCapture
+    void setTrafficCapture(const std::shared_ptr<TrafficCapture>& capture) { capture_ = capture; }
+
+private:
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr& conn);
+
+    EventLoop* loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+    std::shared_ptr<const std::string> namePrefix_;
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    TcpWritePolicy tcpWritePolicy_;
+    bool corkedWrites_;
+    TlsContextPtr tlsContext_;
+    std::shared_ptr<TrafficCapture> capture_;
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    uint64_t nextConnId_;  //只在loop线程里使用
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_;
+};
@@ -3,13 +3,28 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "TlsFilter.h"
+#include "ConnectionPool.h"
+#include "Clock.h"
+#include "MemoryAccountant.h"
+#include "TrafficCapture.h"
 
 #include <functional>
+#include <algorithm>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <strings.h>
 #include <netinet/tcp.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+// 缓冲区内存超过反压线时暂停读取，每隔这么久重新检查一次
+static const double kMemoryRetrySeconds = 0.01;
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
 
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -21,80 +36,186 @@ static EventLoop* CheckLoopNotNull(EventLoop *loop)
 }
 
 TcpConnection::TcpConnection(EventLoop* loop,
-    const std::string& nameArg,
+    uint64_t id,
+    const std::shared_ptr<const std::string>& namePrefix,
     int sockfd,
     const InetAddress& localAddr,
-    const InetAddress& peerAddr)
+    const InetAddress& peerAddr,
+    const std::shared_ptr<ConnectionPool>& pool)
     :loop_(CheckLoopNotNull(loop))
-    ,name_(nameArg)
+    ,id_(id)
+    ,namePrefix_(namePrefix)
     ,state_(kConnecting)
     ,reading_(true)
-    ,socket_(new Socket(sockfd))
-    ,channel_(new Channel(loop,sockfd))
+    ,socket_(sockfd)
+    ,channel_(loop,sockfd)
     ,localAddr_(localAddr)
     ,peerAddr_(peerAddr)
     ,highWaterMark_(64*1024*1024)  //64M
+    ,ingressPaused_(false)
+    ,egressPaused_(false)
+    ,corked_(false)
+    ,flushScheduled_(false)
+    ,tcpCork_(false)
+    ,uncorkScheduled_(false)
+    ,inputBuffer_(pool ? pool->takeBuffer() : Buffer())
+    ,outputBuffer_(pool ? pool->takeBuffer() : Buffer())
+    ,zeroCopyThreshold_(0)
+    ,zeroCopy_(false)
+    ,zeroCopyNextSeq_(0)
+    ,writeCompletePending_(false)
+    ,pool_(pool)
 {
-    //下面给channel设置相应的回调函数，poller给channel通知感兴趣的事件发生了，channel会回调相应的操作函数
-    channel_->setReadCallback(std::bind(&TcpConnection::handleRead,this,std::placeholders::_1));
-    channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite,this));
-    channel_->setCloseCallback(std::bind(&TcpConnection::handleClose,this));
-    channel_->setErrorCallback(std::bind(&TcpConnection::handleError,this));    
+    //poller给channel通知感兴趣的事件发生了，channel直接调用TcpConnection的onChannelXxx
+    channel_.setHandler(this);
+    //Buffer可能来自别的loop的池，用量统一记到所属loop上
+    inputBuffer_.setAccount(loop->memoryAccount());
+    outputBuffer_.setAccount(loop->memoryAccount());
 
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d \n",name_.c_str(),sockfd);
-    socket_->setKeepAlive(true);
+    LOG_INFO("TcpConnection::ctor[%s#%llu] at fd=%d \n",namePrefix_->c_str(),(unsigned long long)id_,sockfd);
+    socket_.setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d\n",
-        name_.c_str(),channel_->fd(),(int)state_);
+    LOG_INFO("TcpConnection::dtor[%s#%llu] at fd=%d state=%d\n",
+        namePrefix_->c_str(),(unsigned long long)id_,channel_.fd(),(int)state_);
+    if(pool_)
+    {
+        pool_->giveBuffer(&inputBuffer_);
+        pool_->giveBuffer(&outputBuffer_);
+    }
+}
+
+std::string TcpConnection::name() const
+{
+    char buf[32];
+    snprintf(buf,sizeof(buf),"#%llu",(unsigned long long)id_);
+    return *namePrefix_ + buf;
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
-    int saveErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(),&saveErrno);
-    if(n>0)
+    if(rawReadCallback_)
     {
-        //已建立连接的用户，有可读事件发生了，调用用户传入的回调操作 onMessage
-        messageCallback_(shared_from_this(),&inputBuffer_,receiveTime);
+        rawReadCallback_(receiveTime);
+        return;
     }
-    else if(n == 0)
+    if(ingressPaused_ || !ingressReady())
     {
-        handleClose();
+        return;
     }
-    else
+    size_t bytes = 0;
+    int messages = 0;
+    bool exhausted = false;
+    do
+    {
+        int saveErrno = 0;
+        size_t maxBytes = budget_.readBytes > 0 ? budget_.readBytes - bytes : 0;
+        if(ingressBytes_.limited()) //不多读令牌之外的数据
+        {
+            size_t tokens = static_cast<size_t>(ingressBytes_.tokens());
+            maxBytes = (maxBytes == 0 || tokens < maxBytes) ? tokens : maxBytes;
+        }
+        //启用TLS时先读到密文缓冲区里，解密之后明文才进入inputBuffer_
+        Buffer* target = (tls_ && !tls_->rxOffloaded()) ? tls_->cipherInput() : &inputBuffer_;
+        const size_t plainBefore = inputBuffer_.readableBytes();
+        size_t limit = target->readFdLimit(maxBytes);
+        ssize_t n = target->readFd(channel_.fd(),&saveErrno,maxBytes);
+        if(n>0)
+        {
+            bytes += n;
+            ++messages;
+            ingressBytes_.consume(n);
+            ingressMessages_.consume(1);
+            bool gotData = true;
+            if(target != &inputBuffer_)
+            {
+                if(!decryptTls())
+                {
+                    return;
+                }
+                gotData = inputBuffer_.readableBytes() > plainBefore; //可能只有握手数据或者半个记录
+            }
+            if(gotData && capture_)
+            {
+                capture_->record(kCaptureIn,id_,inputBuffer_.peek() + plainBefore,
+                    inputBuffer_.readableBytes() - plainBefore);
+            }
+            //已建立连接的用户，有可读事件发生了，调用用户传入的回调操作 onMessage
+            if(gotData && messageCallback_)
+            {
+                messageCallback_(shared_from_this(),&inputBuffer_,receiveTime);
+            }
+            else if(gotData)
+            {
+                inputBuffer_.retrieveAll(); //没有人处理的数据直接丢弃
+            }
+            exhausted = (budget_.readBytes > 0 && bytes >= budget_.readBytes)
+                || (budget_.readMessages > 0 && messages >= budget_.readMessages);
+            if(!ingressReady()) //令牌用完了，剩下的数据留在内核里
+            {
+                return;
+            }
+            if(static_cast<size_t>(n) < limit) //没有读满，fd上的数据已经读空了
+            {
+                break;
+            }
+        }
+        else if(n == 0)
+        {
+            handleClose();
+            return;
+        }
+        else if(messages > 0 && saveErrno == EAGAIN) //预算之内连续读取，已经读空了
+        {
+            break;
+        }
+        else
+        {
+            errno = saveErrno;
+            LOG_ERROR("TcpConnection::handleRead \n");
+            handleError();
+            return;
+        }
+    } while(budget_.limitsRead() && !exhausted && state_ != kDisconnected);
+
+    if(exhausted)
     {
-        errno = saveErrno;
-        LOG_ERROR("TcpConnection::handleRead \n");
-        handleError();
+        channel_.setThrottled(true);
     }
 }
 void TcpConnection::handleWrite()
 {
-    if(channel_->isWriting())
+    if(channel_.isWriting())
     {
+        if(rawWriteCallback_ && outputEmpty())
+        {
+            rawWriteCallback_();
+            return;
+        }
+        if(!egressReady()) //令牌用完了，定时器到期后再打开EPOLLOUT
+        {
+            return;
+        }
+
         int savedError = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(),&savedError);
+        ssize_t n = writeOutput(&savedError);
 
         if(n>0)
         {
-            outputBuffer_.retrieve(n);
-            if(outputBuffer_.readableBytes() == 0) //读完了
+            if(outputEmpty()) //读完了
             {
-                channel_->disableWriting();
-                //唤醒loop_对应的thread线程，执行回调
-                if(writeCompleteCallback_)
+                channel_.disableWriting();
+                outputDrained();
+                if(rawWriteCallback_)
                 {
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_,shared_from_this()));
+                    rawWriteCallback_();
                 }
-                //因为在写过程中，可能发生关闭连接，但是必须把写操作完成后才能关闭连接，此处就是判断是否关闭连接
-                if(state_ == kDisconnecting)
-                {
-                    shutdownInLoop();
-                }
-
+            }
+            else if(budget_.writeBytes > 0 && static_cast<size_t>(n) >= budget_.writeBytes) //本轮写预算用完了
+            {
+                channel_.setThrottled(true);
             }
         }
         else
@@ -104,28 +225,303 @@ void TcpConnection::handleWrite()
     } //可写
     else
     {
-        LOG_ERROR("TcpConnection::handleWrite Connection fd = %d is down, no more writing \n",channel_->fd());
+        LOG_ERROR("TcpConnection::handleWrite Connection fd = %d is down, no more writing \n",channel_.fd());
+    }
+
+}
+
+ssize_t TcpConnection::writeOutput(int* savedErrno)
+{
+    ssize_t n = writeOutput(writeLimit(),savedErrno);
+    if(n > 0)
+    {
+        egressBytes_.consume(n);
+    }
+    return n;
+}
+
+// 先写outputBuffer_，写空之后再按顺序写outputChunks_，总共不超过limit字节(0表示不限)
+ssize_t TcpConnection::writeOutput(size_t limit,int* savedErrno)
+{
+    size_t total = 0;
+    if(outputBuffer_.readableBytes() > 0)
+    {
+        ssize_t n = outputBuffer_.writeFd(channel_.fd(),savedErrno,limit);
+        if(n <= 0)
+        {
+            return n;
+        }
+        outputBuffer_.retrieve(n);
+        total = n;
+        if(outputBuffer_.readableBytes() > 0) //内核发送缓冲区满了或者预算用完了
+        {
+            return total;
+        }
+    }
+
+    while(!outputChunks_.empty())
+    {
+        if(limit > 0 && total >= limit)
+        {
+            break;
+        }
+        OutputChunk& chunk = outputChunks_.front();
+        size_t len = chunk.payload->size() - chunk.offset;
+        if(limit > 0 && len > limit - total)
+        {
+            len = limit - total;
+        }
+        ssize_t n = sendChunk(len,savedErrno);
+        if(n < 0)
+        {
+            return total > 0 ? static_cast<ssize_t>(total) : -1;
+        }
+        chunk.offset += n;
+        total += n;
+        if(chunk.offset < chunk.payload->size())
+        {
+            break;
+        }
+        if(!zeroCopyInflight_.empty() && zeroCopyInflight_.back().payload == chunk.payload)
+        {
+            zeroCopyInflight_.back().sent = true;
+        }
+        outputChunks_.pop_front();
+    }
+    return total;
+}
+
+// 发送outputChunks_队头的len个字节，zerocopy的send调用记到zeroCopyInflight_里
+ssize_t TcpConnection::sendChunk(size_t len,int* savedErrno)
+{
+    OutputChunk& chunk = outputChunks_.front();
+    const char* data = chunk.payload->data() + chunk.offset;
+    bool zeroCopy = chunk.zeroCopy && zeroCopy_;
+    ssize_t n = ::send(channel_.fd(),data,len,MSG_NOSIGNAL | (zeroCopy ? MSG_ZEROCOPY : 0));
+    if(n < 0 && zeroCopy && errno == ENOBUFS) //超过了optmem限制，这一次退回普通发送
+    {
+        zeroCopy = false;
+        n = ::send(channel_.fd(),data,len,MSG_NOSIGNAL);
     }
+    if(n < 0)
+    {
+        *savedErrno = errno;
+        return n;
+    }
+    if(zeroCopy)
+    {
+        uint32_t seq = zeroCopyNextSeq_++;
+        if(!zeroCopyInflight_.empty()
+            && !zeroCopyInflight_.back().sent
+            && zeroCopyInflight_.back().payload == chunk.payload)
+        {
+            ZeroCopyInflight& inflight = zeroCopyInflight_.back();
+            inflight.lastSeq = seq;
+            ++inflight.pending;
+        }
+        else
+        {
+            ZeroCopyInflight inflight;
+            inflight.payload = chunk.payload;
+            inflight.firstSeq = seq;
+            inflight.lastSeq = seq;
+            inflight.pending = 1;
+            inflight.sent = false;
+            zeroCopyInflight_.push_back(inflight);
+        }
+    }
+    return n;
+}
 
+// 数据全部交给内核之后的处理
+void TcpConnection::outputDrained()
+{
+    scheduleUncork();
+    offloadTlsTx();
+    //每次写空只通知一次，和zerocopy是否完成无关
+    if(outputDrainedCallback_)
+    {
+        loop_->queueInLoop(std::bind(outputDrainedCallback_,shared_from_this()));
+    }
+    notifyWriteComplete();
+    //因为在写过程中，可能发生关闭连接，但是必须把写操作完成后才能关闭连接，此处就是判断是否关闭连接
+    if(state_ == kDisconnecting)
+    {
+        shutdownInLoop();
+    }
+}
+
+// 还有zerocopy数据没有完成时，writeCompleteCallback_推迟到handleZeroCopyCompletions
+void TcpConnection::notifyWriteComplete()
+{
+    releaseCompletedPayloads();
+    if(!zeroCopyInflight_.empty())
+    {
+        writeCompletePending_ = true;
+        return;
+    }
+    writeCompletePending_ = false;
+    //唤醒loop_对应的thread线程，执行回调
+    if(writeCompleteCallback_)
+    {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_,shared_from_this()));
+    }
+}
+
+// corked模式下，本轮loop处理完事件之后把攒下的数据一次写出去
+void TcpConnection::flushInLoop()
+{
+    flushScheduled_ = false;
+    flushOutput();
+}
+
+void TcpConnection::flushOutput()
+{
+    //已经注册了EPOLLOUT的话，剩下的数据交给handleWrite
+    if(state_ == kDisconnected || channel_.isWriting() || outputEmpty() || !egressReady())
+    {
+        return;
+    }
+
+    int savedErrno = 0;
+    ssize_t n = writeOutput(&savedErrno);
+    if(outputEmpty())
+    {
+        outputDrained();
+        return;
+    }
+    if(n < 0 && savedErrno != EWOULDBLOCK)
+    {
+        LOG_ERROR("TcpConnection::flushOutput errno:%d \n",savedErrno);
+        if(savedErrno == EPIPE || savedErrno == ECONNRESET)
+        {
+            return;
+        }
+    }
+    channel_.enableWriting();
+}
+
+// TCP_CORK打开时，本轮loop结束前拔掉cork再塞回去，把不满一个MSS的尾部数据推出去
+void TcpConnection::scheduleUncork()
+{
+    if(tcpCork_ && !uncorkScheduled_)
+    {
+        uncorkScheduled_ = true;
+        loop_->queueInLoop(std::bind(&TcpConnection::uncorkInLoop,shared_from_this()));
+    }
+}
+
+void TcpConnection::uncorkInLoop()
+{
+    uncorkScheduled_ = false;
+    if(tcpCork_ && state_ != kDisconnected)
+    {
+        socket_.setTcpCork(false);
+        socket_.setTcpCork(true);
+    }
+}
+
+void TcpConnection::startTls(const TlsContextPtr& ctx)
+{
+    tls_.reset(new TlsFilter(ctx,channel_.fd()));
+}
+
+bool TcpConnection::tlsHandshakeDone() const
+{
+    return tls_ && tls_->handshakeDone();
+}
+
+bool TcpConnection::tlsOffloaded() const
+{
+    return tls_ && tls_->txOffloaded() && tls_->rxOffloaded();
+}
+
+// 解密tls_里的密文，握手需要回复的数据直接写给socket
+bool TcpConnection::decryptTls()
+{
+    std::string out;
+    bool ok = tls_->decrypt(&inputBuffer_,&out);
+    if(!out.empty())
+    {
+        sendInLoop(out.data(),out.size());
+    }
+    if(!ok)
+    {
+        LOG_ERROR("TcpConnection::decryptTls [%s] tls error, closing \n",name().c_str());
+        handleClose();
+        return false;
+    }
+    offloadTlsTx();
+    return true;
+}
+
+// 握手产生的密文都写进socket以后，发送方向才能交给内核
+void TcpConnection::offloadTlsTx()
+{
+    if(tls_ && tls_->handshakeDone() && !tls_->txOffloaded() && outputEmpty())
+    {
+        tls_->offloadTx();
+    }
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_.setTcpNoDelay(on);
+}
+
+void TcpConnection::setTcpCork(bool on)
+{
+    tcpCork_ = on;
+    socket_.setTcpCork(on);
 }
 
 //poller => channel::closeCallback => TcpConnection::handleClose 
 void TcpConnection::handleClose()
 {
-    LOG_INFO("TcpConnection::handleClose fd = %d, state = %d \n",channel_->fd(),(int)state_);
+    LOG_INFO("TcpConnection::handleClose fd = %d, state = %d \n",channel_.fd(),(int)state_);
+    //对端挂断时EPOLLHUP和EPOLLIN会同时到达，handleRead读到0还会再进来一次，只关闭一次
+    if(state_ == kDisconnected)
+    {
+        return;
+    }
+    if(capture_)
+    {
+        capture_->record(kCaptureClose,id_,nullptr,0);
+    }
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
 
     TcpConnectionPtr connPtr(shared_from_this());
-    connectionCallback_(connPtr); //执行连接关闭的回调
+    if(connectionCallback_)
+    {
+        connectionCallback_(connPtr); //执行连接关闭的回调
+    }
     closeCallback_(connPtr); //关闭连接的回调 执行的是TcpServer::removeConnection回调方法
 }
+// EPOLLHUP: 两个方向都已经关闭
+void TcpConnection::handleHangup()
+{
+    //raw模式下接收缓冲区里可能还有数据，交给rawReadCallback_读完，由接管者决定什么时候关闭
+    if(rawReadCallback_ && state_ != kDisconnected)
+    {
+        return;
+    }
+    handleClose();
+}
+
 void TcpConnection::handleError()
 {
+    //zerocopy的完成通知也是通过EPOLLERR上报的，先把错误队列读空
+    bool completions = false;
+    if(zeroCopy_ || !zeroCopyInflight_.empty())
+    {
+        handleZeroCopyCompletions();
+        completions = true;
+    }
     int optval;
     socklen_t optlen = static_cast<socklen_t>(sizeof optval);
     int err = 0;
-    if(::getsockopt(channel_->fd(),SOL_SOCKET,SO_ERROR,&optval,&optlen) < 0)
+    if(::getsockopt(channel_.fd(),SOL_SOCKET,SO_ERROR,&optval,&optlen) < 0)
     {
         err = errno;
     }
@@ -133,7 +529,101 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n",name_.c_str(),err);
+    if(err == 0 && completions)
+    {
+        return;
+    }
+    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n",name().c_str(),err);
+}
+
+// 读取socket错误队列里的zerocopy完成通知，释放已经完成的payload
+void TcpConnection::handleZeroCopyCompletions()
+{
+    for(;;)
+    {
+        char control[128];
+        struct msghdr msg;
+        bzero(&msg,sizeof msg);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        if(::recvmsg(channel_.fd(),&msg,MSG_ERRQUEUE) < 0)
+        {
+            break; //EAGAIN，错误队列已经读空
+        }
+        for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg,cm))
+        {
+            if(!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+            {
+                continue;
+            }
+            const struct sock_extended_err* ee = reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+            if(ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+            if(ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                //内核还是做了拷贝(比如回环网卡)，zerocopy只剩下额外开销，后面的数据不再使用
+                zeroCopy_ = false;
+            }
+            //[lo,hi]这一段send调用都完成了
+            uint32_t lo = ee->ee_info;
+            uint32_t hi = ee->ee_data;
+            for(ZeroCopyInflight& inflight : zeroCopyInflight_)
+            {
+                uint32_t first = inflight.firstSeq > lo ? inflight.firstSeq : lo;
+                uint32_t last = inflight.lastSeq < hi ? inflight.lastSeq : hi;
+                if(first <= last)
+                {
+                    inflight.pending -= last - first + 1;
+                }
+            }
+        }
+    }
+
+    releaseCompletedPayloads();
+    if(writeCompletePending_ && zeroCopyInflight_.empty() && outputEmpty())
+    {
+        notifyWriteComplete();
+    }
+}
+
+// 完成通知可能先于payload最后一段(退回普通发送的部分)写完到达，所以写完时也要检查一次
+void TcpConnection::releaseCompletedPayloads()
+{
+    while(!zeroCopyInflight_.empty()
+        && zeroCopyInflight_.front().sent
+        && zeroCopyInflight_.front().pending == 0)
+    {
+        zeroCopyInflight_.pop_front();
+    }
+}
+
+void TcpConnection::setZeroCopyThreshold(size_t threshold)
+{
+    zeroCopyThreshold_ = threshold;
+    zeroCopy_ = threshold > 0 && socket_.setZeroCopy(true);
+    if(threshold > 0 && !zeroCopy_)
+    {
+        LOG_INFO("TcpConnection::setZeroCopyThreshold fd=%d does not support SO_ZEROCOPY \n",channel_.fd());
+    }
+}
+
+size_t TcpConnection::memoryUsage() const
+{
+    return inputBuffer_.internalCapacity() + outputBuffer_.internalCapacity()
+        + (outputBytes() - outputBuffer_.readableBytes());
+}
+
+size_t TcpConnection::outputBytes() const
+{
+    size_t bytes = outputBuffer_.readableBytes();
+    for(const OutputChunk& chunk : outputChunks_)
+    {
+        bytes += chunk.payload->size() - chunk.offset;
+    }
+    return bytes;
 }
 
 void TcpConnection::send(const std::string& buf)
@@ -142,18 +632,117 @@ void TcpConnection::send(const std::string& buf)
     {
         if(loop_->isInLoopThread()) //刚好在此线程中
         {
-            sendInLoop(buf.c_str(),buf.size());
+            sendPlainInLoop(buf.c_str(),buf.size());
+        }
+        else
+        {
+            //跨线程发送时必须拷贝一份数据，并且持有连接，调用者的buf随时可能被释放
+            void (TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
+            loop_->runInLoop(std::bind(fp,shared_from_this(),buf));
+        }
+    }
+}
+
+void TcpConnection::send(const void* data,size_t len)
+{
+    if(state_ == kConnected)
+    {
+        if(loop_->isInLoopThread())
+        {
+            sendPlainInLoop(data,len);
         }
         else
         {
-            loop_->runInLoop(std::bind(
-                &TcpConnection::sendInLoop,
-                this,
-                buf.c_str(),
-                buf.size()
-            ));
+            void (TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
+            loop_->runInLoop(std::bind(fp,shared_from_this(),std::string(static_cast<const char*>(data),len)));
+        }
+    }
+}
+
+void TcpConnection::send(const SharedPayload& payload)
+{
+    if(state_ == kConnected)
+    {
+        if(loop_->isInLoopThread())
+        {
+            sendPayloadInLoop(payload);
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&TcpConnection::sendPayloadInLoop,shared_from_this(),payload));
+        }
+    }
+}
+
+void TcpConnection::sendInLoop(const std::string& message)
+{
+    sendPlainInLoop(message.data(),message.size());
+}
+
+// 用户数据的入口，启用了TLS时先加密，sendInLoop之后只处理要写给socket的字节
+void TcpConnection::sendPlainInLoop(const void* data,size_t len)
+{
+    if(capture_ && state_ != kDisconnected)
+    {
+        capture_->record(kCaptureOut,id_,data,len);
+    }
+    if(tls_ && !tls_->txOffloaded())
+    {
+        std::string cipher;
+        if(!tls_->encrypt(static_cast<const char*>(data),len,&cipher))
+        {
+            forceClose();
+            return;
+        }
+        if(!cipher.empty()) //握手还没完成时明文先缓存在tls_里
+        {
+            sendInLoop(cipher.data(),cipher.size());
+        }
+        return;
+    }
+    sendInLoop(data,len);
+}
+
+void TcpConnection::sendPayloadInLoop(const SharedPayload& payload)
+{
+    if(state_ == kDisconnected)
+    {
+        LOG_ERROR("TcpConnection::sendPayloadInLoop disconnectd,give up writing \n");
+        return;
+    }
+    //TLS的密文只能由OpenSSL生成，payload没法原样发送
+    if(tls_ && !tls_->txOffloaded())
+    {
+        sendPlainInLoop(payload->data(),payload->size());
+        return;
+    }
+    if(capture_)
+    {
+        capture_->record(kCaptureOut,id_,payload->data(),payload->size());
+    }
+    //小数据拷贝进outputBuffer_更划算，前面有排队的payload时直接引用，不用拷贝
+    bool zeroCopy = zeroCopy_ && payload->size() >= zeroCopyThreshold_;
+    if(!zeroCopy && outputChunks_.empty())
+    {
+        sendInLoop(payload->data(),payload->size());
+        return;
+    }
+
+    outputChunks_.push_back(OutputChunk(payload,zeroCopy));
+    if(channel_.isWriting()) //handleWrite会按顺序写出
+    {
+        return;
+    }
+    if(corked_)
+    {
+        if(!flushScheduled_)
+        {
+            flushScheduled_ = true;
+            loop_->queueInLoop(std::bind(&TcpConnection::flushInLoop,shared_from_this()));
         }
+        return;
     }
+    flushOutput();
 }
 
 //发送数据   应用写的快，而内核发送数据慢，需要把待发送的数据写入缓冲区，而且设置了水位回调
@@ -170,17 +759,47 @@ void TcpConnection::sendInLoop(const void* message,size_t len)
         return;
     }
 
+    //前面还有排队的payload，为了保持顺序，这份数据拷贝一份排在它们后面
+    if(!outputChunks_.empty())
+    {
+        outputChunks_.push_back(OutputChunk(
+            std::make_shared<const std::string>(static_cast<const char*>(message),len),false));
+        return;
+    }
+
+    //corked模式: 本轮事件处理中的多次send先攒在outputBuffer_里，处理完事件之后统一flush一次
+    if(corked_)
+    {
+        size_t oldLen = outputBuffer_.readableBytes();
+        if(oldLen + len >= highWaterMark_
+        && oldLen < highWaterMark_
+        && highWaterMarkCallback_)
+        {
+            loop_->queueInLoop(std::bind(highWaterMarkCallback_,shared_from_this(),oldLen+len));
+        }
+        outputBuffer_.append(static_cast<const char*>(message),len);
+        if(!channel_.isWriting() && !flushScheduled_)
+        {
+            flushScheduled_ = true;
+            loop_->queueInLoop(std::bind(&TcpConnection::flushInLoop,shared_from_this()));
+        }
+        return;
+    }
+
     //表示channel_第一次开始写数据，并且缓冲区没有待发送的数据
-    if(!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    if(!channel_.isWriting() && outputBuffer_.readableBytes() == 0 && egressReady())
     {
-        nwrote = ::write(channel_->fd(),message,len);
+        size_t limit = writeLimit();
+        size_t toWrite = (limit > 0 && limit < len) ? limit : len;
+        nwrote = ::write(channel_.fd(),message,toWrite);
         if(nwrote >= 0)
         {
+            egressBytes_.consume(nwrote);
             remaining = len - nwrote;
-            if(remaining == 0 && writeCompleteCallback_)
+            if(remaining == 0)
             {
                 //既然在这里数据全部发送完成，就不用再给channel设置epollout事件了
-                loop_->queueInLoop(std::bind(writeCompleteCallback_,shared_from_this()));
+                outputDrained();
             }
         }
         else
@@ -211,9 +830,9 @@ void TcpConnection::sendInLoop(const void* message,size_t len)
             loop_->queueInLoop(std::bind(highWaterMarkCallback_,shared_from_this(),oldLen+remaining));
         }
         outputBuffer_.append(static_cast<const char*>(message)+nwrote,remaining);
-        if(!channel_->isWriting())
+        if(!channel_.isWriting() && !egressPaused_) //限速暂停时由定时器打开EPOLLOUT
         {
-            channel_->enableWriting();  //这里一定要注册channel的写事件，否则poller不会给channel通知epollout
+            channel_.enableWriting();  //这里一定要注册channel的写事件，否则poller不会给channel通知epollout
         }
     }
 }
@@ -222,11 +841,31 @@ void TcpConnection::sendInLoop(const void* message,size_t len)
 void TcpConnection::connectEstablished()
 {
     setState(kConnected);
-    channel_->tie(shared_from_this());
-    channel_->enableReading();  //向Poller注册channel的读事件epollin
+    if(capture_)
+    {
+        capture_->record(kCaptureOpen,id_,nullptr,0);
+    }
+    channel_.enableReading();  //向Poller注册channel的读事件epollin
+
+    //客户端先发出ClientHello
+    if(tls_ && !tls_->handshakeDone())
+    {
+        std::string out;
+        if(!tls_->start(&out))
+        {
+            LOG_ERROR("TcpConnection::connectEstablished [%s] tls start failed \n",name().c_str());
+        }
+        if(!out.empty())
+        {
+            sendInLoop(out.data(),out.size());
+        }
+    }
 
     //新连接建立，执行回调
-    connectionCallback_(shared_from_this());
+    if(connectionCallback_)
+    {
+        connectionCallback_(shared_from_this());
+    }
 }
 
 
@@ -236,11 +875,18 @@ void TcpConnection::connectDestroyed()
     if(state_ == kConnected)
     {
         setState(kDisconnected);
-        channel_->disableAll(); //把channel的所有感兴趣的事件，从poller中del掉
+        channel_.disableAll(); //把channel的所有感兴趣的事件，从poller中del掉
+        if(capture_)
+        {
+            capture_->record(kCaptureClose,id_,nullptr,0);
+        }
 
-        connectionCallback_(shared_from_this());
+        if(connectionCallback_)
+        {
+            connectionCallback_(shared_from_this());
+        }
     }
-    channel_->remove(); //把channel从poller中删除
+    channel_.remove(); //把channel从poller中删除
 }
 
 // 关闭连接
@@ -250,15 +896,186 @@ void TcpConnection::shutdown()
     {
         setState(kDisconnecting);
         loop_->runInLoop(
-            std::bind(&TcpConnection::shutdownInLoop,this)
+            std::bind(&TcpConnection::shutdownInLoop,shared_from_this())
         );
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop,shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
+void TcpConnection::startRead()
+{
+    if(ingressPaused_) //限速暂停中，等定时器恢复
+    {
+        reading_ = true;
+        return;
+    }
+    if(!reading_ || !channel_.isReading())
+    {
+        channel_.enableReading();
+        reading_ = true;
+    }
+}
+
+void TcpConnection::stopRead()
+{
+    if(reading_ || channel_.isReading())
+    {
+        channel_.disableReading();
+        reading_ = false;
+    }
+}
+
+void TcpConnection::setIngressLimit(const RateLimit& limit)
+{
+    int64_t now = Clock::nowNs();
+    ingressLimit_ = limit;
+    ingressBytes_.reset(limit.bytesPerSecond,limit.burstBytes,now);
+    ingressMessages_.reset(limit.messagesPerSecond,limit.burstMessages,now);
+}
+
+void TcpConnection::setEgressLimit(const RateLimit& limit)
+{
+    egressLimit_ = limit;
+    egressBytes_.reset(limit.bytesPerSecond,limit.burstBytes,Clock::nowNs());
+}
+
+size_t TcpConnection::writeLimit() const
+{
+    size_t limit = budget_.writeBytes;
+    if(egressBytes_.limited())
+    {
+        size_t tokens = static_cast<size_t>(egressBytes_.tokens());
+        limit = (limit == 0 || tokens < limit) ? tokens : limit;
+    }
+    return limit;
+}
+
+bool TcpConnection::ingressReady()
+{
+    if(MemoryAccountant::readBackpressure()) //整个进程的缓冲区内存紧张，先不读
+    {
+        pauseIngress(kMemoryRetrySeconds);
+        return false;
+    }
+    if(!ingressBytes_.limited() && !ingressMessages_.limited())
+    {
+        return true;
+    }
+    int64_t now = loop_->pollReturnNs();
+    ingressBytes_.refill(now);
+    ingressMessages_.refill(now);
+    double wait = std::max(ingressBytes_.waitSeconds(),ingressMessages_.waitSeconds());
+    if(wait <= 0)
+    {
+        return true;
+    }
+    pauseIngress(wait);
+    return false;
+}
+
+void TcpConnection::pauseIngress(double seconds)
+{
+    ingressPaused_ = true;
+    if(channel_.isReading())
+    {
+        channel_.disableReading();
+    }
+    loop_->runAfter(seconds,std::bind(&TcpConnection::resumeIngress,std::weak_ptr<TcpConnection>(shared_from_this())));
+}
+
+bool TcpConnection::egressReady()
+{
+    if(!egressBytes_.limited())
+    {
+        return true;
+    }
+    if(egressPaused_)
+    {
+        return false;
+    }
+    egressBytes_.refill(loop_->pollReturnNs());
+    double wait = egressBytes_.waitSeconds();
+    if(wait <= 0)
+    {
+        return true;
+    }
+    egressPaused_ = true;
+    if(channel_.isWriting())
+    {
+        channel_.disableWriting();
+    }
+    loop_->runAfter(wait,std::bind(&TcpConnection::resumeEgress,std::weak_ptr<TcpConnection>(shared_from_this())));
+    return false;
+}
+
+void TcpConnection::resumeIngress(const std::weak_ptr<TcpConnection>& weakConn)
+{
+    TcpConnectionPtr conn(weakConn.lock());
+    if(!conn || !conn->ingressPaused_)
+    {
+        return;
+    }
+    conn->ingressPaused_ = false;
+    //期间用户stopRead过的话保持暂停
+    if(conn->reading_ && conn->state_ != kDisconnected && !conn->channel_.isReading())
+    {
+        conn->channel_.enableReading();
+    }
+}
+
+void TcpConnection::resumeEgress(const std::weak_ptr<TcpConnection>& weakConn)
+{
+    TcpConnectionPtr conn(weakConn.lock());
+    if(!conn || !conn->egressPaused_)
+    {
+        return;
+    }
+    conn->egressPaused_ = false;
+    //剩下的数据交给handleWrite，它会再检查令牌
+    if(conn->state_ != kDisconnected && !conn->outputEmpty() && !conn->channel_.isWriting())
+    {
+        conn->channel_.enableWriting();
+    }
+}
+
+void TcpConnection::watchWritable(bool on)
+{
+    if(on && !channel_.isWriting())
+    {
+        channel_.enableWriting();
+    }
+    else if(!on && channel_.isWriting() && outputEmpty())
+    {
+        channel_.disableWriting();
+    }
+}
+
+int TcpConnection::fd() const
+{
+    return channel_.fd();
+}
+
 void TcpConnection::shutdownInLoop()
 {
-    if(!channel_->isWriting()) //说明当前outputbuffer中的数据已经全部发送完成
+    //说明当前outputbuffer中的数据已经全部发送完成，corked模式下还可能有没flush的数据
+    if(!channel_.isWriting() && outputEmpty())
     {
-        socket_->shutdownWrite();
+        socket_.shutdownWrite();
     }
 }
\ No newline at end of file
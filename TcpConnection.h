@@ -5,14 +5,53 @@
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "TlsContext.h"
+#include "Channel.h"
+#include "Socket.h"
+#include "RateLimit.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
+#include <deque>
+#include <functional>
 
-class Channel;
 class EventLoop;
-class Socket;
+class ConnectionPool;
+class TlsFilter;
+class Strand;
+class TrafficCapture;
+
+// 每轮loop迭代里单个连接的读写预算，字段为0表示不限制
+struct IoBudget
+{
+    explicit IoBudget(size_t readBytesArg = 0,int readMessagesArg = 0,size_t writeBytesArg = 0)
+        :readBytes(readBytesArg)
+        ,readMessages(readMessagesArg)
+        ,writeBytes(writeBytesArg)
+    {}
+
+    bool limitsRead() const { return readBytes > 0 || readMessages > 0; }
+
+    size_t readBytes;   //每轮最多读取的字节数
+    int readMessages;   //每轮最多回调messageCallback_的次数
+    size_t writeBytes;  //每轮最多写出的字节数
+};
+
+/*
+新连接socket的TCP写策略
+    kTcpNoDelay: 打开TCP_NODELAY(默认)，写出去的数据立即成段发送。小包的合并交给corked模式在用户态完成，
+                 不需要再让Nagle算法等一个RTT
+    kTcpNagle:   保持内核默认的Nagle算法
+    kTcpCork:    同时打开TCP_NODELAY和TCP_CORK，内核只发送满MSS的段；数据写空之后在本轮loop结束前临时拔掉cork，把尾部推出去，
+                 适合一次响应分多次大块写出的批量传输
+*/
+enum TcpWritePolicy
+{
+    kTcpNoDelay,
+    kTcpNagle,
+    kTcpCork,
+};
 
 /*
 TcpServer => Acceptor => 有一个新用户连接，通过accept函数拿到connfd
@@ -20,28 +59,106 @@ TcpServer => Acceptor => 有一个新用户连接，通过accept函数拿到conn
 => TcpConnection 设置回调 => Channel => Poller => Channel的回调操作
 */
 
-class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
+class TcpConnection : noncopyable, private ChannelHandler, public std::enable_shared_from_this<TcpConnection>
 {
 public:
     TcpConnection(EventLoop* loop,
-                const std::string& nameArg,
+                uint64_t id,
+                const std::shared_ptr<const std::string>& namePrefix,
                 int sockfd,
                 const InetAddress& localAddr,
-                const InetAddress& peerAddr);
+                const InetAddress& peerAddr,
+                const std::shared_ptr<ConnectionPool>& pool = std::shared_ptr<ConnectionPool>());
     ~TcpConnection();
 
     EventLoop* getLoop() const { return loop_; }
-    const std::string& name() const { return name_; }
+    // 连接的唯一id，TcpServer用它在连接表里定位连接
+    uint64_t id() const { return id_; }
+    // 可读的连接名 "<server>-<ip:port>#<id>"，只在打日志或者用户需要的时候才拼出来
+    std::string name() const;
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
     bool disconnected() const { return state_ == kDisconnected; }
 
+    // 只能在连接所属的loop线程里访问
+    Buffer* inputBuffer() { return &inputBuffer_; }
+    Buffer* outputBuffer() { return &outputBuffer_; }
+    // 还没有写进内核的字节数(outputBuffer_加上排队的payload)
+    size_t outputBytes() const;
+    // 连接占用的缓冲区内存: 两个Buffer的容量加上排队的payload，过载时按它挑选要关掉的连接
+    size_t memoryUsage() const;
+
+    // 上层协议/框架挂在连接上的状态，比如协程层的会话
+    void setContext(const std::shared_ptr<void>& context) { context_ = context; }
+    const std::shared_ptr<void>& getContext() const { return context_; }
+    // 这个连接上保序处理用的Strand，见ComputePool::submitOrdered；在连接所属的loop线程里设置
+    void setStrand(const std::shared_ptr<Strand>& strand) { strand_ = strand; }
+    const std::shared_ptr<Strand>& strand() const { return strand_; }
+
     //发送数据
     void send(const std::string& buf);
+    // 在loop线程里直接发送，不经过std::string；跨线程时拷贝一份
+    void send(const void* data,size_t len);
+    // 发送引用计数的数据，跨线程也不拷贝；达到zerocopy阈值时用MSG_ZEROCOPY发送
+    void send(const SharedPayload& payload);
+
+    /*
+    SharedPayload不小于threshold字节时走MSG_ZEROCOPY，内核直接从payload的内存发送，
+    payload一直被持有到socket错误队列里的完成通知覆盖它为止，writeCompleteCallback也等到那时才回调
+    threshold为0表示关闭；socket不支持SO_ZEROCOPY(比如unix域)时自动关闭
+    只能在连接所属的loop线程里调用，或者在connectEstablished之前调用
+    */
+    void setZeroCopyThreshold(size_t threshold);
+
+    /*
+    corked模式: 一次事件处理里的多次send只追加到outputBuffer_，等本轮loop处理完事件之后
+    每个连接只flush一次，header/body/trailer分三次send也只有一次系统调用
+    只能在连接所属的loop线程里调用，或者在connectEstablished之前调用
+    */
+    void setCorked(bool on) { corked_ = on; }
+    bool corked() const { return corked_; }
+
+    void setTcpNoDelay(bool on);
+    void setTcpCork(bool on);
+
+    // 把这个连接收到的和send出去的字节记进capture，见TrafficCapture；传空指针关闭
+    // 只能在连接所属的loop线程里调用，或者在connectEstablished之前调用
+    void setTrafficCapture(const std::shared_ptr<TrafficCapture>& capture) { capture_ = capture; }
+
+    /*
+    在这个连接上启用TLS，send的数据先加密再进入outputBuffer_，读到的密文解密后才进入inputBuffer_
+    客户端在connectEstablished时发起握手，握手完成前send的数据先缓存，连接回调不等握手
+    必须在connectEstablished之前调用
+    */
+    void startTls(const TlsContextPtr& ctx);
+    bool tlsHandshakeDone() const;
+    // 收发两个方向是否都已经切换到kTLS
+    bool tlsOffloaded() const;
     // 关闭连接
     void shutdown();
+    // 不等待输出数据，直接关闭连接
+    void forceClose();
+
+    // 暂停/恢复读取，暂停期间数据留在内核接收缓冲区里，由TCP流控反压对端
+    // 只能在连接所属的loop线程里调用
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
+    /*
+    接管socket的读写事件，数据不经过inputBuffer_/outputBuffer_，比如Relay用splice直接转发
+        rawReadCallback:  fd可读时代替readFd + messageCallback_
+        rawWriteCallback: fd可写并且outputBuffer_已经写空时回调，需要先watchWritable(true)
+    只能在连接所属的loop线程里调用
+    */
+    using RawReadCallback = std::function<void(Timestamp)>;
+    using RawWriteCallback = std::function<void()>;
+    void setRawReadCallback(const RawReadCallback& cb) { rawReadCallback_ = cb; }
+    void setRawWriteCallback(const RawWriteCallback& cb) { rawWriteCallback_ = cb; }
+    void watchWritable(bool on);
+    int fd() const;
 
     void setConnectionCallback(const ConnectionCallback& cb)
     { connectionCallback_ = cb; }
@@ -56,6 +173,29 @@ public:
         highWaterMarkCallback_ = cb;
         highWaterMark_ = highWaterMark;  
     }
+    // 给库内部的设施(比如Broadcaster)用: 输出全部写进内核时回调，和writeCompleteCallback互不影响
+    // 只能在连接所属的loop线程里设置
+    void setOutputDrainedCallback(const WriteCompleteCallback& cb)
+    { outputDrainedCallback_ = cb; }
+
+    /*
+    设置读写预算后，handleRead会在预算之内反复读取直到读空fd，用完预算就停下，
+    剩下的数据留给下一轮(LT模式下poller会再次上报)，EventLoop把这样的连接排在下一轮的最后轮转处理
+    只能在连接所属的loop线程里调用，或者在connectEstablished之前调用
+    */
+    void setIoBudget(const IoBudget& budget) { budget_ = budget; }
+    const IoBudget& ioBudget() const { return budget_; }
+
+    /*
+    入/出方向的令牌桶限速，不超过限速时和不限速一样直接读写
+    入方向令牌用完时关掉EPOLLIN，数据留在内核接收缓冲区里由TCP流控反压对端，loop定时器补够令牌后再打开；
+    出方向用完时不再写socket，数据留在outputBuffer_里，定时器到期后继续写，积压照常由高水位回调处理
+    只能在连接所属的loop线程里调用，或者在connectEstablished之前调用
+    */
+    void setIngressLimit(const RateLimit& limit);
+    void setEgressLimit(const RateLimit& limit);
+    const RateLimit& ingressLimit() const { return ingressLimit_; }
+    const RateLimit& egressLimit() const { return egressLimit_; }
 
     //建立连接
     void connectEstablished();
@@ -66,22 +206,57 @@ private:
     void handleRead(Timestamp receiveTime);
     void handleWrite();
     void handleClose();
+    void handleHangup();
     void handleError();
 
+    // ChannelHandler: channel上的事件直接调到这里，不经过std::function和tie
+    void onChannelRead(Timestamp receiveTime) override { handleRead(receiveTime); }
+    void onChannelWrite() override { handleWrite(); }
+    void onChannelClose() override { handleHangup(); }
+    void onChannelError() override { handleError(); }
+
     void sendInLoop(const void* message,size_t len);
+    void sendInLoop(const std::string& message);
+    void sendPayloadInLoop(const SharedPayload& payload);
+    void sendPlainInLoop(const void* data,size_t len);
+    bool decryptTls();
+    void offloadTlsTx();
+    void flushInLoop();
+    void flushOutput();
+    ssize_t writeOutput(int* savedErrno);
+    ssize_t writeOutput(size_t limit,int* savedErrno);
+    // 本次最多还能写多少字节(读写预算和出方向令牌取小的)，0表示不限
+    size_t writeLimit() const;
+    // 令牌够用时返回true，否则暂停这个方向并安排定时器恢复
+    bool ingressReady();
+    bool egressReady();
+    void pauseIngress(double seconds);
+    static void resumeIngress(const std::weak_ptr<TcpConnection>& weakConn);
+    static void resumeEgress(const std::weak_ptr<TcpConnection>& weakConn);
+    ssize_t sendChunk(size_t len,int* savedErrno);
+    bool outputEmpty() const { return outputBuffer_.readableBytes() == 0 && outputChunks_.empty(); }
+    void outputDrained();
+    void notifyWriteComplete();
+    void handleZeroCopyCompletions();
+    void releaseCompletedPayloads();
+    void scheduleUncork();
+    void uncorkInLoop();
 
     void setState(StateE s) { state_ = s; }
 
     void shutdownInLoop();
+    void forceCloseInLoop();
 
     EventLoop* loop_;  //绝对不是base_loop，因为TcpConnection都是在subloop里面管理的 
-    const std::string name_;
+    const uint64_t id_;
+    std::shared_ptr<const std::string> namePrefix_; //同一个TcpServer的所有连接共享一份名字前缀
     std::atomic_int state_;
     bool reading_;
 
     //和Acceptor类似  Accept在mainLoop里，TcpConnection在subloop里
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    //直接作为成员和连接对象放在同一块内存里，见ConnectionPool
+    Socket socket_;
+    Channel channel_;
 
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
@@ -91,8 +266,56 @@ private:
     WriteCompleteCallback writeCompleteCallback_;
     CloseCallback closeCallback_;
     HighWaterMarkCallback highWaterMarkCallback_;
+    WriteCompleteCallback outputDrainedCallback_;
+    RawReadCallback rawReadCallback_;
+    RawWriteCallback rawWriteCallback_;
     size_t highWaterMark_;
+    IoBudget budget_;
+    RateLimit ingressLimit_;
+    RateLimit egressLimit_;
+    TokenBucket ingressBytes_;
+    TokenBucket ingressMessages_;
+    TokenBucket egressBytes_;
+    bool ingressPaused_;  //因为限速关掉了EPOLLIN，和用户的stopRead互不影响
+    bool egressPaused_;   //因为限速暂停了写socket
+    bool corked_;         //send先攒起来，本轮loop结束前统一flush
+    bool flushScheduled_; //本轮是否已经安排了flush
+    bool tcpCork_;        //socket是否打开了TCP_CORK
+    bool uncorkScheduled_;
 
     Buffer inputBuffer_;
     Buffer outputBuffer_;
+
+    // 排在outputBuffer_之后等待发送的SharedPayload，有它们的时候后续send也按顺序排在这里
+    struct OutputChunk
+    {
+        OutputChunk(const SharedPayload& payloadArg,bool zeroCopyArg)
+            :payload(payloadArg),offset(0),zeroCopy(zeroCopyArg)
+        {}
+
+        SharedPayload payload;
+        size_t offset;
+        bool zeroCopy;
+    };
+    // 已经用MSG_ZEROCOPY交给内核、还在等完成通知的payload，[firstSeq,lastSeq]是这些send调用的序号
+    struct ZeroCopyInflight
+    {
+        SharedPayload payload;
+        uint32_t firstSeq;
+        uint32_t lastSeq;
+        uint32_t pending; //还没收到完成通知的send调用个数
+        bool sent;        //payload已经全部交给内核
+    };
+    std::deque<OutputChunk> outputChunks_;
+    std::deque<ZeroCopyInflight> zeroCopyInflight_;
+    size_t zeroCopyThreshold_;
+    bool zeroCopy_;              //socket打开了SO_ZEROCOPY
+    uint32_t zeroCopyNextSeq_;   //内核给每次成功的MSG_ZEROCOPY send调用分配的序号
+    bool writeCompletePending_;  //数据已经写完，等zerocopy完成后再回调writeCompleteCallback_
+
+    std::shared_ptr<void> context_;
+    std::shared_ptr<Strand> strand_;
+    std::unique_ptr<TlsFilter> tls_;
+    std::shared_ptr<ConnectionPool> pool_; //析构时把Buffer交还给它
+    std::shared_ptr<TrafficCapture> capture_;
 };
\ No newline at end of file
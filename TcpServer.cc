@@ -1,9 +1,15 @@
 #include"TcpServer.h"
 #include"Logger.h"
 #include"TcpConnection.h"
+#include"ConnectionPool.h"
 
 #include <strings.h>
 #include <functional>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// 检查缓冲区内存是否超出预算的间隔，秒
+static const double kMemoryCheckInterval = 0.1;
 
 EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -21,12 +27,20 @@ TcpServer::TcpServer(EventLoop* loop,
     :loop_(CheckLoopNotNull(loop))
     ,ipPort_(listenAddr.toIpPort())
     ,name_(nameArg)
+    ,namePrefix_(std::make_shared<const std::string>(nameArg+"-"+ipPort_))
     ,acceptor_(new Acceptor(loop,listenAddr,option == kReusePort))
     ,threadpool_(new EventLoopThreadPool(loop,name_))
     ,connectionCallback_()
     ,messageCallback_()
-    ,nextConnId_(1)
+    ,corkedWrites_(false)
+    ,tcpWritePolicy_(kTcpNoDelay)
+    ,zeroCopyThreshold_(0)
     ,start_(0)
+    ,sharded_(false)
+    ,numConnections_(0)
+    ,rejected_(0)
+    ,shed_(0)
+    ,memoryTimerStarted_(false)
 {
     //当有新用户连接时，会执行TcpServer::newConnection回调
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection,this,
@@ -36,55 +50,301 @@ TcpServer::TcpServer(EventLoop* loop,
 
 TcpServer::~TcpServer()
 {
-    for(auto& item : connections_)
+    if(memoryTimerStarted_)
+    {
+        loop_->cancel(memoryTimer_);
+    }
+    connections_.forEach([](TcpConnectionPtr& item)
     {
-        TcpConnectionPtr conn(item.second); //这个局部的shared_ptr职能指针对象，出右括号，可以自动释放new出来的TcpConnection对象资源
-        item.second.reset();
+        TcpConnectionPtr conn(item); //这个局部的shared_ptr职能指针对象，出右括号，可以自动释放new出来的TcpConnection对象资源
+        item.reset();
 
         //销毁连接
         conn->getLoop()->runInLoop(
             std::bind(&TcpConnection::connectDestroyed,conn)
         );
+    });
+    connections_.clear();
+
+    //分片模式下连接表属于各个subloop，由它们自己销毁各自的连接
+    for(auto& item : loopConnections_)
+    {
+        ConnectionTablePtr table(item.second);
+        item.first->runInLoop([table]()
+        {
+            table->forEach([](TcpConnectionPtr& conn)
+            {
+                conn->connectDestroyed();
+            });
+            table->clear();
+        });
     }
 }
 
 // 有一个新的客户端连接，acceptor会执行这个回调操作
 void TcpServer::newConnection(int sockfd,const InetAddress& peerAddr)
 {
-    //轮询算法，选择一个subLoop，来管理channel
-    EventLoop* ioLoop = threadpool_->getNextLoop();
-    char buf[1024] = {0};
-    snprintf(buf,sizeof(buf),"-%s#%d",ipPort_.c_str(),nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_+buf;
-
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
-        name_.c_str(),connName.c_str(),peerAddr.toIpPort().c_str());
+    //轮询算法，选择一个subLoop，来管理channel；超过准入限制的连接直接关掉
+    EventLoop* ioLoop = admitConnection(peerAddr);
+    if(ioLoop == nullptr)
+    {
+        rejectConnection(sockfd,peerAddr);
+        return;
+    }
 
     //通过sockfd获取其绑定的本机的ip地址和端口信息
-    struct sockaddr_in local;
+    struct sockaddr_storage local;
     bzero(&local,sizeof(local));
     socklen_t addrlen = sizeof(local);
     if(::getsockname(sockfd,(sockaddr*)&local,&addrlen) < 0)
     {
         LOG_ERROR("sockets::getLocalAddr");
     }
-    InetAddress localAddr(local);
+    InetAddress localAddr((sockaddr*)&local,addrlen);
+
+    if(sharded_)
+    {
+        //连接对象的创建和注册都交给subloop自己完成
+        ioLoop->runInLoop(std::bind(&TcpServer::newConnectionInLoop,this,ioLoop,sockfd,localAddr,peerAddr));
+        return;
+    }
+
+    //先占一个槽位拿到连接id，连接对象创建好之后再填进去
+    uint64_t connId = connections_.insert(TcpConnectionPtr());
+
+    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s#%llu] from %s \n",
+        name_.c_str(),namePrefix_->c_str(),(unsigned long long)connId,peerAddr.toIpPort().c_str());
 
     //根据连接成功的sockfd，创建TcpConnection连接对象
-    TcpConnectionPtr conn(new TcpConnection(ioLoop,connName,sockfd,localAddr,peerAddr));
-    connections_[connName] = conn;
+    //连接对象在baseloop线程里创建，从baseloop的池里分配，subloop释放后再批量还回来
+    TcpConnectionPtr conn(loop_->connectionPool()->create(ioLoop,connId,namePrefix_,sockfd,localAddr,peerAddr));
+    *connections_.find(connId) = conn;
+    setupConnection(conn);
+    //直接调用TcpConnection::connectEstablished
+    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished,conn));
+    
+}
+
+// 分片模式下，在ioLoop线程里创建连接并登记到ioLoop自己的连接表
+void TcpServer::newConnectionInLoop(EventLoop* ioLoop,int sockfd,const InetAddress& localAddr,const InetAddress& peerAddr)
+{
+    ConnectionTable& table = tableOf(ioLoop);
+    uint64_t connId = table.insert(TcpConnectionPtr());
+
+    LOG_INFO("TcpServer::newConnectionInLoop [%s] - new connection [%s#%llu] from %s \n",
+        name_.c_str(),namePrefix_->c_str(),(unsigned long long)connId,peerAddr.toIpPort().c_str());
+
+    TcpConnectionPtr conn(ioLoop->connectionPool()->create(ioLoop,connId,namePrefix_,sockfd,localAddr,peerAddr));
+    *table.find(connId) = conn;
+    setupConnection(conn);
+    conn->connectEstablished();
+}
+
+void TcpServer::setupConnection(const TcpConnectionPtr& conn)
+{
     //下面的回调都是用户设置给TcpServer=>TcpConnection=>Channel=>Poller=>notify channel调用回调
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setIoBudget(ioBudget_);
+    if(ingressLimit_.limited())
+    {
+        conn->setIngressLimit(ingressLimit_);
+    }
+    if(egressLimit_.limited())
+    {
+        conn->setEgressLimit(egressLimit_);
+    }
+    conn->setCorked(corkedWrites_);
+    if(tlsContext_)
+    {
+        conn->startTls(tlsContext_);
+    }
+    std::shared_ptr<TrafficCapture> capture = std::atomic_load(&capture_);
+    if(capture)
+    {
+        conn->setTrafficCapture(capture);
+    }
+    sa_family_t family = conn->localAddress().family();
+    if(family == AF_INET || family == AF_INET6)
+    {
+        if(tcpWritePolicy_ == kTcpNoDelay)
+        {
+            conn->setTcpNoDelay(true);
+        }
+        else if(tcpWritePolicy_ == kTcpCork)
+        {
+            //同时打开TCP_NODELAY，拔掉cork时尾部数据不用再等Nagle的ACK
+            conn->setTcpNoDelay(true);
+            conn->setTcpCork(true);
+        }
+        if(zeroCopyThreshold_ > 0)
+        {
+            conn->setZeroCopyThreshold(zeroCopyThreshold_);
+        }
+    }
     //设置了如何关闭连接的回调 conn->shutdown
     conn->setCloseCallback(
         std::bind(&TcpServer::removeConnection,this,std::placeholders::_1)
     );
-    //直接调用TcpConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished,conn));
-    
+}
+
+EventLoop* TcpServer::admitConnection(const InetAddress& peerAddr)
+{
+    //只有baseloop在这里增加计数，先检查再加不会超过上限
+    if(admission_.maxConnections > 0 && numConnections_ >= admission_.maxConnections)
+    {
+        return nullptr;
+    }
+
+    EventLoop* ioLoop = nullptr;
+    for(size_t i=0;i<loopLoads_.size();i++)
+    {
+        EventLoop* loop = threadpool_->getNextLoop();
+        if(loopAvailable(loop))
+        {
+            ioLoop = loop;
+            break;
+        }
+    }
+    if(ioLoop == nullptr)
+    {
+        return nullptr;
+    }
+
+    sa_family_t family = peerAddr.family();
+    if(admission_.maxConnectionsPerIp > 0 && (family == AF_INET || family == AF_INET6))
+    {
+        std::lock_guard<std::mutex> lock(ipMutex_);
+        size_t& count = ipConnections_[peerAddr.toIp()];
+        if(count >= admission_.maxConnectionsPerIp)
+        {
+            return nullptr;
+        }
+        ++count;
+    }
+    ++numConnections_;
+    ++*loopLoads_.find(ioLoop)->second;
+    return ioLoop;
+}
+
+bool TcpServer::loopAvailable(EventLoop* ioLoop) const
+{
+    if(admission_.maxConnectionsPerLoop > 0
+        && *loopLoads_.find(ioLoop)->second >= admission_.maxConnectionsPerLoop)
+    {
+        return false;
+    }
+    if(admission_.maxLoopLagUs > 0 && ioLoop->lagNs() > admission_.maxLoopLagUs * 1000)
+    {
+        return false;
+    }
+    if(admission_.maxPendingFunctors > 0 && ioLoop->pendingFunctorCount() > admission_.maxPendingFunctors)
+    {
+        return false;
+    }
+    return true;
+}
+
+void TcpServer::rejectConnection(int sockfd,const InetAddress& peerAddr)
+{
+    ++rejected_;
+    (void)peerAddr; //没有定义MUDEBUG时LOG_DEBUG展开为空
+    LOG_DEBUG("TcpServer::rejectConnection [%s] - reject connection from %s \n",
+        name_.c_str(),peerAddr.toIpPort().c_str());
+    if(!admission_.rejectMessage.empty())
+    {
+        //新连接的发送缓冲区是空的，短的响应一次就能写进去，写不进去也不等
+        ::send(sockfd,admission_.rejectMessage.data(),admission_.rejectMessage.size(),MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    ::close(sockfd);
+}
+
+void TcpServer::releaseConnection(const TcpConnectionPtr& conn)
+{
+    --numConnections_;
+    --*loopLoads_.find(conn->getLoop())->second;
+    sa_family_t family = conn->peerAddress().family();
+    if(admission_.maxConnectionsPerIp > 0 && (family == AF_INET || family == AF_INET6))
+    {
+        std::lock_guard<std::mutex> lock(ipMutex_);
+        auto it = ipConnections_.find(conn->peerAddress().toIp());
+        if(it != ipConnections_.end() && --it->second == 0)
+        {
+            ipConnections_.erase(it);
+        }
+    }
+}
+
+void TcpServer::shedMemory()
+{
+    if(!MemoryAccountant::overBudget())
+    {
+        return;
+    }
+    if(sharded_)
+    {
+        for(auto& item : loopConnections_)
+        {
+            ConnectionTablePtr table(item.second);
+            item.first->runInLoop([this,table]()
+            {
+                std::vector<TcpConnectionPtr> conns;
+                table->forEach([&conns](TcpConnectionPtr& conn) { conns.push_back(conn); });
+                closeLargest(conns);
+            });
+        }
+        return;
+    }
+    //连接表在baseloop里，按所属loop分组后交给各自的loop比较，memoryUsage只能在连接的loop里读
+    std::unordered_map<EventLoop*,std::vector<TcpConnectionPtr>> byLoop;
+    connections_.forEach([&byLoop](TcpConnectionPtr& conn)
+    {
+        if(conn)
+        {
+            byLoop[conn->getLoop()].push_back(conn);
+        }
+    });
+    for(auto& item : byLoop)
+    {
+        item.first->runInLoop(std::bind(&TcpServer::closeLargest,this,std::move(item.second)));
+    }
+}
+
+void TcpServer::closeLargest(const std::vector<TcpConnectionPtr>& conns)
+{
+    if(!MemoryAccountant::overBudget())
+    {
+        return;
+    }
+    TcpConnectionPtr largest;
+    size_t largestUsage = 0;
+    for(const TcpConnectionPtr& conn : conns)
+    {
+        size_t usage = conn->memoryUsage();
+        if(conn->connected() && usage > largestUsage)
+        {
+            largest = conn;
+            largestUsage = usage;
+        }
+    }
+    if(largest)
+    {
+        ++shed_;
+        LOG_ERROR("TcpServer::closeLargest [%s] - buffer memory %lld over budget %zu, close %s using %zu bytes \n",
+            name_.c_str(),(long long)MemoryAccountant::totalBytes(),MemoryAccountant::budget(),
+            largest->name().c_str(),largestUsage);
+        largest->forceClose();
+    }
+}
+
+TcpServer::ConnectionTable& TcpServer::tableOf(EventLoop* ioLoop)
+{
+    if(sharded_)
+    {
+        return *loopConnections_.find(ioLoop)->second;
+    }
+    return connections_;
 }
 
 //设置底层subloop的个数
@@ -99,21 +359,75 @@ void TcpServer::start()   // 防止一个TcpServer对象被start多次
     if(start_++ == 0)
     {
         threadpool_->start(threadInitCallback_); // 启动底层loop线程池
+        for(EventLoop* ioLoop : threadpool_->getAllLoops())
+        {
+            loopLoads_[ioLoop].reset(new std::atomic<size_t>(0));
+        }
+        if(sharded_)
+        {
+            //shard 0留给baseloop的connections_，各subloop的表从1开始编号，保证id全局唯一
+            std::vector<EventLoop*> loops = threadpool_->getAllLoops();
+            for(size_t i=0;i<loops.size();i++)
+            {
+                loopConnections_[loops[i]] = std::make_shared<ConnectionTable>(static_cast<uint16_t>(i+1));
+            }
+        }
+        //定期检查内存预算，超出预算就关掉占用最多的连接；预算可以在start()之后才设置，没有预算时检查什么也不做
+        memoryTimer_ = loop_->runEvery(kMemoryCheckInterval,std::bind(&TcpServer::shedMemory,this));
+        memoryTimerStarted_ = true;
         loop_->runInLoop(std::bind(&Acceptor::listen,acceptor_.get()));
     }
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
+    if(sharded_)
+    {
+        //handleClose就运行在连接所属的subloop里，直接从它自己的表里删除
+        removeConnectionInLoop(conn);
+        return;
+    }
     loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop,this,conn));
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
 {
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connetion %s \n",name_.c_str(),conn->name().c_str());
-    size_t n = connections_.erase(conn->name());
+    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connetion %s#%llu \n",
+        name_.c_str(),namePrefix_->c_str(),(unsigned long long)conn->id());
     EventLoop* ioLoop = conn->getLoop();
+    //同一个连接的关闭回调只处理一次，否则准入计数会被减两次
+    if(!tableOf(ioLoop).erase(conn->id()))
+    {
+        return;
+    }
+    releaseConnection(conn);
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed,conn)
     );
+}
+
+void TcpServer::forEachConnection(const ConnectionCallback& cb)
+{
+    if(sharded_)
+    {
+        for(auto& item : loopConnections_)
+        {
+            ConnectionTablePtr table(item.second);
+            item.first->runInLoop([table,cb]()
+            {
+                table->forEach([&cb](TcpConnectionPtr& conn) { cb(conn); });
+            });
+        }
+    }
+    else
+    {
+        //连接表只在baseloop里访问，cb要转到连接自己的loop里执行
+        loop_->runInLoop([this,cb]()
+        {
+            connections_.forEach([&cb](TcpConnectionPtr& conn)
+            {
+                conn->getLoop()->runInLoop(std::bind(cb,conn));
+            });
+        });
+    }
 }
\ No newline at end of file
@@ -8,12 +8,37 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "SlotTable.h"
 
 #include <functional>
 #include <string>
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <mutex>
+
+/*
+TcpServer的准入控制，字段为0表示不限制
+超过限制的连接在accept之后直接关闭(可以先写一段固定的拒绝响应)，不创建TcpConnection，不打扰subloop
+轮询选subloop时跳过连接数满了或者过载(滞后、排队的回调过多)的loop，所有loop都不行时拒绝
+*/
+struct AdmissionPolicy
+{
+    AdmissionPolicy()
+        :maxConnections(0)
+        ,maxConnectionsPerLoop(0)
+        ,maxConnectionsPerIp(0)
+        ,maxLoopLagUs(0)
+        ,maxPendingFunctors(0)
+    {}
+
+    size_t maxConnections;        //整个服务器的连接数
+    size_t maxConnectionsPerLoop; //每个subloop的连接数
+    size_t maxConnectionsPerIp;   //同一个对端IP的连接数，unix域连接不受影响
+    int64_t maxLoopLagUs;         //subloop的滞后超过它时认为过载，见EventLoop::lagNs
+    size_t maxPendingFunctors;    //subloop排队的回调超过它时认为过载
+    std::string rejectMessage;    //拒绝之前写给对端的内容，只尝试写一次
+};
 
 //对外的服务器编程使用的类
 class TcpServer : noncopyable
@@ -44,18 +69,75 @@ public:
     void setWriteCompleteCallback(const WriteCompleteCallback& cb)
     { writeCompleteCallback_ = cb; }
 
+    // 新连接是否使用corked模式合并写，见TcpConnection::setCorked
+    void setCorkedWrites(bool on) { corkedWrites_ = on; }
+    // 新的TCP连接的TCP_NODELAY/TCP_CORK策略，默认kTcpNoDelay，unix域连接不受影响
+    void setTcpWritePolicy(TcpWritePolicy policy) { tcpWritePolicy_ = policy; }
+    // 新连接的MSG_ZEROCOPY阈值，见TcpConnection::setZeroCopyThreshold
+    void setZeroCopyThreshold(size_t threshold) { zeroCopyThreshold_ = threshold; }
+
+    // 新连接启用TLS，见TcpConnection::startTls
+    void setTlsContext(const TlsContextPtr& ctx) { tlsContext_ = ctx; }
+
+    // 新连接的流量记进capture，见TrafficCapture；已经建立的连接不受影响，传空指针停止
+    // 可以在运行中跨线程调用
+    void setTrafficCapture(const std::shared_ptr<TrafficCapture>& capture) { std::atomic_store(&capture_,capture); }
+
+    // 新连接的每轮读写预算，见TcpConnection::setIoBudget
+    void setIoBudget(const IoBudget& budget) { ioBudget_ = budget; }
+
+    // 新连接默认的入/出方向限速，连接回调里可以用TcpConnection::setIngressLimit/setEgressLimit单独覆盖
+    void setIngressLimit(const RateLimit& limit) { ingressLimit_ = limit; }
+    void setEgressLimit(const RateLimit& limit) { egressLimit_ = limit; }
+
+    /*
+    分片模式: 每个subloop持有自己的连接表，连接的创建、注册、删除和销毁都在所属的subloop里完成，
+    关闭连接时不再需要 subloop => baseloop => subloop 两次跨线程唤醒
+    必须在start()之前设置
+    */
+    void setShardedConnections(bool on) { sharded_ = on; }
+
+    // 准入控制和过载保护，必须在start()之前设置
+    void setAdmissionPolicy(const AdmissionPolicy& policy) { admission_ = policy; }
+    // 当前的连接数和累计拒绝的连接数，可以跨线程读取
+    size_t numConnections() const { return numConnections_; }
+    uint64_t rejectedConnections() const { return rejected_; }
+    // 因为缓冲区内存超出MemoryAccountant的预算被关掉的连接数，预算随时可以设置或修改
+    uint64_t shedConnections() const { return shed_; }
+
+    // 在每个连接所属的loop里对它执行cb，分片模式下是向所有subloop广播
+    void forEachConnection(const ConnectionCallback& cb);
+
     //开启服务器监听
     void start();
 private:
     void newConnection(int sockfd,const InetAddress& peerAddr);
+    void newConnectionInLoop(EventLoop* ioLoop,int sockfd,const InetAddress& localAddr,const InetAddress& peerAddr);
     void removeConnection(const TcpConnectionPtr& conn);
     void removeConnectionInLoop(const TcpConnectionPtr& conn);
+    // 把服务器上的连接配置应用到新连接上
+    void setupConnection(const TcpConnectionPtr& conn);
+    // 准入检查并选出subloop，拒绝时返回nullptr；通过时计数已经加上
+    EventLoop* admitConnection(const InetAddress& peerAddr);
+    bool loopAvailable(EventLoop* ioLoop) const;
+    void rejectConnection(int sockfd,const InetAddress& peerAddr);
+    // 连接移除时减掉admitConnection加上的计数
+    void releaseConnection(const TcpConnectionPtr& conn);
+    // 缓冲区内存超出预算时，在每个subloop里关掉占用最多的连接
+    void shedMemory();
+    void closeLargest(const std::vector<TcpConnectionPtr>& conns);
+
+    // 连接表用整数id做key，连接名只有在打印的时候才拼接
+    using ConnectionTable = SlotTable<TcpConnectionPtr>;
+    using ConnectionTablePtr = std::shared_ptr<ConnectionTable>;
 
-    using ConnectionMap = std::unordered_map<std::string,TcpConnectionPtr>;
+    // 连接所在的表: 分片模式下是ioLoop自己的表，否则是baseloop里的connections_
+    ConnectionTable& tableOf(EventLoop* ioLoop);
     EventLoop *loop_;  //baseloop 用户定义的loop
 
     const std::string ipPort_;
     const std::string name_;
+    const std::shared_ptr<const std::string> namePrefix_; // "<name>-<ip:port>"，所有连接共享
 
     std::unique_ptr<Acceptor> acceptor_; // 运行在mainloop，任务就是监听新连接事件
 
@@ -65,8 +147,31 @@ private:
     MessageCallback messageCallback_; //有读写消息时的回调
     WriteCompleteCallback writeCompleteCallback_; //消息发送完成以后的回调
     ThreadInitCallback threadInitCallback_; //loop线程初始化的回调
+    IoBudget ioBudget_; //每个连接每轮loop的读写预算
+    RateLimit ingressLimit_;
+    RateLimit egressLimit_;
+    bool corkedWrites_;
+    TcpWritePolicy tcpWritePolicy_;
+    size_t zeroCopyThreshold_;
+    TlsContextPtr tlsContext_;
+    std::shared_ptr<TrafficCapture> capture_; //用atomic_load/atomic_store访问
     std::atomic_int start_;
 
-    int nextConnId_;
-    ConnectionMap connections_; //保存所有的连接
+    ConnectionTable connections_; //保存所有的连接
+
+    bool sharded_;
+    // 分片模式下subloop => 它的连接表，start()之后只读，每张表只在所属loop线程里访问
+    std::unordered_map<EventLoop*,ConnectionTablePtr> loopConnections_;
+
+    AdmissionPolicy admission_;
+    std::atomic<size_t> numConnections_;
+    std::atomic<uint64_t> rejected_;
+    // subloop => 它上面的连接数，start()之后只读
+    std::unordered_map<EventLoop*,std::unique_ptr<std::atomic<size_t>>> loopLoads_;
+    std::mutex ipMutex_; //保护ipConnections_，只在设置了maxConnectionsPerIp时使用
+    std::unordered_map<std::string,size_t> ipConnections_;
+
+    std::atomic<uint64_t> shed_;
+    TimerId memoryTimer_;
+    bool memoryTimerStarted_;
 };
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <functional>
+#include <atomic>
+#include <stdint.h>
+
+// 定时器，expiration和interval都以单调时钟的微秒计
+class Timer : noncopyable
+{
+public:
+    using TimerCallback = std::function<void()>;
+
+    Timer(TimerCallback cb,int64_t expiration,int64_t interval)
+        :callback_(std::move(cb))
+        ,expiration_(expiration)
+        ,interval_(interval)
+        ,repeat_(interval > 0)
+        ,sequence_(++numCreated_)
+    {}
+
+    void run() const { callback_(); }
+
+    int64_t expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 重复定时器从now开始计算下一次超时时间
+    void restart(int64_t now) { expiration_ = now + interval_; }
+
+private:
+    const TimerCallback callback_;
+    int64_t expiration_;
+    const int64_t interval_;
+    const bool repeat_;
+    const int64_t sequence_; //区分地址相同的新旧Timer对象
+
+    static std::atomic<int64_t> numCreated_;
+};
@@ -0,0 +1,176 @@
+#include "TimerQueue.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Clock.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+std::atomic<int64_t> Timer::numCreated_(0);
+
+static int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK | TFD_CLOEXEC);
+    if(timerfd < 0)
+    {
+        LOG_FATAL("timerfd_create error:%d \n",errno);
+    }
+    return timerfd;
+}
+
+int64_t TimerQueue::now()
+{
+    return Clock::nowNs() / 1000;
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    :loop_(loop)
+    ,timerfd_(createTimerfd())
+    ,timerfdChannel_(loop,timerfd_)
+    ,callingExpiredTimers_(false)
+{
+    timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead,this));
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+    for(const Entry& timer : timers_)
+    {
+        delete timer.second;
+    }
+}
+
+TimerId TimerQueue::addTimer(Timer::TimerCallback cb,int64_t when,int64_t interval)
+{
+    Timer *timer = new Timer(std::move(cb),when,interval);
+    loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop,this,timer));
+    return TimerId(timer,timer->sequence());
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop,this,timerId));
+}
+
+void TimerQueue::addTimerInLoop(Timer *timer)
+{
+    bool earliestChanged = insert(timer);
+    if(earliestChanged)
+    {
+        resetTimerfd(timer->expiration());
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId)
+{
+    ActiveTimer timer(timerId.timer_,timerId.sequence_);
+    ActiveTimerSet::iterator it = activeTimers_.find(timer);
+    if(it != activeTimers_.end())
+    {
+        timers_.erase(Entry(it->first->expiration(),it->first));
+        delete it->first;
+        activeTimers_.erase(it);
+    }
+    else if(callingExpiredTimers_)
+    {
+        //正在执行的定时器回调里取消了自己
+        cancelingTimers_.insert(timer);
+    }
+}
+
+void TimerQueue::handleRead()
+{
+    int64_t nowTime = now();
+    uint64_t howmany;
+    ssize_t n = ::read(timerfd_,&howmany,sizeof howmany);
+    if(n != sizeof howmany)
+    {
+        LOG_ERROR("TimerQueue::handleRead() reads %ld bytes instead of 8 \n",n);
+    }
+
+    std::vector<Entry> expired = getExpired(nowTime);
+
+    callingExpiredTimers_ = true;
+    cancelingTimers_.clear();
+    for(const Entry& it : expired)
+    {
+        it.second->run();
+    }
+    callingExpiredTimers_ = false;
+
+    reset(expired,nowTime);
+}
+
+std::vector<TimerQueue::Entry> TimerQueue::getExpired(int64_t nowTime)
+{
+    std::vector<Entry> expired;
+    Entry sentry(nowTime,reinterpret_cast<Timer*>(UINTPTR_MAX));
+    TimerList::iterator end = timers_.lower_bound(sentry);
+    expired.assign(timers_.begin(),end);
+    timers_.erase(timers_.begin(),end);
+
+    for(const Entry& it : expired)
+    {
+        activeTimers_.erase(ActiveTimer(it.second,it.second->sequence()));
+    }
+    return expired;
+}
+
+void TimerQueue::reset(const std::vector<Entry> &expired,int64_t nowTime)
+{
+    for(const Entry& it : expired)
+    {
+        ActiveTimer timer(it.second,it.second->sequence());
+        if(it.second->repeat() && cancelingTimers_.find(timer) == cancelingTimers_.end())
+        {
+            it.second->restart(nowTime);
+            insert(it.second);
+        }
+        else
+        {
+            delete it.second;
+        }
+    }
+
+    if(!timers_.empty())
+    {
+        resetTimerfd(timers_.begin()->second->expiration());
+    }
+}
+
+bool TimerQueue::insert(Timer *timer)
+{
+    bool earliestChanged = false;
+    int64_t when = timer->expiration();
+    TimerList::iterator it = timers_.begin();
+    if(it == timers_.end() || when < it->first)
+    {
+        earliestChanged = true;
+    }
+    timers_.insert(Entry(when,timer));
+    activeTimers_.insert(ActiveTimer(timer,timer->sequence()));
+    return earliestChanged;
+}
+
+void TimerQueue::resetTimerfd(int64_t expiration)
+{
+    int64_t microseconds = expiration - now();
+    if(microseconds < 100)
+    {
+        microseconds = 100;
+    }
+    struct itimerspec newValue;
+    memset(&newValue,0,sizeof newValue);
+    newValue.it_value.tv_sec = static_cast<time_t>(microseconds / 1000000);
+    newValue.it_value.tv_nsec = static_cast<long>((microseconds % 1000000) * 1000);
+    if(::timerfd_settime(timerfd_,0,&newValue,nullptr) < 0)
+    {
+        LOG_ERROR("timerfd_settime error:%d \n",errno);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Channel.h"
+#include "Timer.h"
+#include "TimerId.h"
+
+#include <set>
+#include <vector>
+#include <stdint.h>
+
+class EventLoop;
+
+/*
+定时器队列，基于timerfd，把定时器事件和IO事件统一交给Poller处理
+timers_按超时时间排序，timerfd总是设置成最早的那个超时时间
+*/
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // when和interval都是单调时钟的微秒数，interval>0表示重复定时器，可以跨线程调用
+    TimerId addTimer(Timer::TimerCallback cb,int64_t when,int64_t interval);
+    void cancel(TimerId timerId);
+
+    // 单调时钟的当前时间，微秒
+    static int64_t now();
+
+private:
+    using Entry = std::pair<int64_t,Timer*>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*,int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读，说明有定时器超时了
+    void handleRead();
+
+    std::vector<Entry> getExpired(int64_t now);
+    void reset(const std::vector<Entry> &expired,int64_t now);
+    // 返回插入的定时器是否成为了最早超时的定时器
+    bool insert(Timer *timer);
+    void resetTimerfd(int64_t expiration);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_;            //按超时时间排序的定时器
+    ActiveTimerSet activeTimers_; //按地址排序的同一批定时器，用于取消
+
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_; //在定时器回调里被取消的重复定时器，不能再次加入队列
+};
@@ -1,27 +1,40 @@
 #include"Timestamp.h"
 
-#include<time.h>
+#include<stdio.h>
 
-Timestamp::Timestamp():microSecondsSinceEpoch_(){}
+Timestamp::Timestamp():microSecondsSinceEpoch_(0){}
 
-Timestamp::Timestamp(int microSecondsSinceEpoch)
+Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
+    :microSecondsSinceEpoch_(microSecondsSinceEpoch)
 {
-    microSecondsSinceEpoch_ = microSecondsSinceEpoch;
 }
 
 Timestamp Timestamp::now()
 {
-    time_t ti = time(NULL);
-    return Timestamp(ti);
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME,&ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
 }
 
 std::string Timestamp::toString() const 
 {
-    char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf,128,"%4d/%02d/%02d %02d:%02d:%02d",
-        tm_time->tm_year+1900,tm_time->tm_mon+1,tm_time->tm_mday,
-        tm_time->tm_hour,tm_time->tm_min,tm_time->tm_sec);
+    return toFormattedString(false);
+}
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
+{
+    char buf[64] = {0};
+    time_t seconds = secondsSinceEpoch();
+    struct tm tm_time;
+    ::localtime_r(&seconds,&tm_time);
+    int len = snprintf(buf,sizeof buf,"%4d/%02d/%02d %02d:%02d:%02d",
+        tm_time.tm_year+1900,tm_time.tm_mon+1,tm_time.tm_mday,
+        tm_time.tm_hour,tm_time.tm_min,tm_time.tm_sec);
+    if(showMicroseconds)
+    {
+        int microseconds = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        snprintf(buf+len,sizeof buf-len,".%06d",microseconds);
+    }
     return buf;
 }
 
@@ -32,4 +45,4 @@ std::string Timestamp::toString() const
 //     std::cout<<Timestamp::now().toString()<<std::endl;
 
 //     return 0;
-// }
\ No newline at end of file
+// }
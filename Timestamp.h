@@ -2,15 +2,49 @@
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
+#include <time.h>
 
+/*
+墙上时间，精度是微秒(clock_gettime(CLOCK_REALTIME)，走vDSO，不陷入内核)
+用来给日志打时间、给messageCallback传receiveTime；测量耗时请用Clock::nowNs()，它不受校时影响
+*/
 class Timestamp
 {
 public:
+    static const int64_t kMicroSecondsPerSecond = 1000 * 1000;
+
     Timestamp();
-    explicit Timestamp(int microSecondsSinceEpoch);
+    explicit Timestamp(int64_t microSecondsSinceEpoch);
     static Timestamp now();
+
+    // 2024/01/02 03:04:05
     std::string toString() const;
+    // 2024/01/02 03:04:05.123456
+    std::string toFormattedString(bool showMicroseconds = true) const;
+
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const
+    { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
 
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs,Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs,Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// high - low，单位秒
+inline double timeDifference(Timestamp high,Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
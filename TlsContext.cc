@@ -0,0 +1,119 @@
+#include "TlsContext.h"
+#include "TlsFilter.h"
+#include "Logger.h"
+
+#ifdef MYMUDUO_TLS
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+static void logSslError(const char* where)
+{
+    char errBuf[256]; //不能叫buf，LOG_ERROR宏里有同名的局部变量
+    ERR_error_string_n(ERR_get_error(),errBuf,sizeof errBuf);
+    LOG_ERROR("%s: %s \n",where,errBuf);
+}
+
+static void keylogCallback(const SSL* ssl,const char* line)
+{
+    TlsFilter* filter = static_cast<TlsFilter*>(SSL_get_ex_data(ssl,TlsFilter::exDataIndex()));
+    if(filter != nullptr)
+    {
+        filter->onKeyLog(line);
+    }
+}
+
+std::shared_ptr<TlsContext> TlsContext::newServer(const std::string& certFile,const std::string& keyFile)
+{
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    if(ctx == nullptr)
+    {
+        logSslError("SSL_CTX_new");
+        LOG_FATAL("%s:%s:%d create SSL_CTX failed! \n",__FILE__,__FUNCTION__,__LINE__);
+    }
+    if(SSL_CTX_use_certificate_chain_file(ctx,certFile.c_str()) != 1
+        || SSL_CTX_use_PrivateKey_file(ctx,keyFile.c_str(),SSL_FILETYPE_PEM) != 1
+        || SSL_CTX_check_private_key(ctx) != 1)
+    {
+        logSslError("TlsContext::newServer");
+        LOG_FATAL("%s:%s:%d load %s / %s failed! \n",__FILE__,__FUNCTION__,__LINE__,certFile.c_str(),keyFile.c_str());
+    }
+    return std::make_shared<TlsContext>(ctx,true);
+}
+
+std::shared_ptr<TlsContext> TlsContext::newClient(const std::string& caFile)
+{
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    if(ctx == nullptr)
+    {
+        logSslError("SSL_CTX_new");
+        LOG_FATAL("%s:%s:%d create SSL_CTX failed! \n",__FILE__,__FUNCTION__,__LINE__);
+    }
+    if(!caFile.empty())
+    {
+        if(SSL_CTX_load_verify_locations(ctx,caFile.c_str(),nullptr) != 1)
+        {
+            logSslError("TlsContext::newClient");
+            LOG_FATAL("%s:%s:%d load %s failed! \n",__FILE__,__FUNCTION__,__LINE__,caFile.c_str());
+        }
+        SSL_CTX_set_verify(ctx,SSL_VERIFY_PEER,nullptr);
+    }
+    return std::make_shared<TlsContext>(ctx,false);
+}
+
+TlsContext::TlsContext(SSL_CTX* ctx,bool server)
+    :ctx_(ctx)
+    ,server_(server)
+    ,kernelTls_(false)
+{
+    //非阻塞的内存BIO下，SSL_write可能只写出一部分，缓冲区地址也可能变化
+    SSL_CTX_set_mode(ctx_,SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+}
+
+TlsContext::~TlsContext()
+{
+    SSL_CTX_free(ctx_);
+}
+
+void TlsContext::setKernelTls(bool on)
+{
+    kernelTls_ = on;
+    SSL_CTX_set_keylog_callback(ctx_,on ? keylogCallback : nullptr);
+    if(server_)
+    {
+        SSL_CTX_set_num_tickets(ctx_,on ? 0 : 2);
+    }
+}
+
+#else
+
+std::shared_ptr<TlsContext> TlsContext::newServer(const std::string&,const std::string&)
+{
+    LOG_FATAL("%s:%s:%d mymuduo was built without OpenSSL! \n",__FILE__,__FUNCTION__,__LINE__);
+    return nullptr;
+}
+
+std::shared_ptr<TlsContext> TlsContext::newClient(const std::string&)
+{
+    LOG_FATAL("%s:%s:%d mymuduo was built without OpenSSL! \n",__FILE__,__FUNCTION__,__LINE__);
+    return nullptr;
+}
+
+TlsContext::TlsContext(SSL_CTX* ctx,bool server)
+    :ctx_(ctx)
+    ,server_(server)
+    ,kernelTls_(false)
+{
+    LOG_FATAL("%s:%s:%d mymuduo was built without OpenSSL! \n",__FILE__,__FUNCTION__,__LINE__);
+}
+
+TlsContext::~TlsContext()
+{
+}
+
+void TlsContext::setKernelTls(bool on)
+{
+    kernelTls_ = on;
+}
+
+#endif
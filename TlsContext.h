@@ -0,0 +1,44 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <string>
+
+typedef struct ssl_ctx_st SSL_CTX;
+
+/*
+TLS配置，内部是OpenSSL的SSL_CTX，同一个TcpServer/TcpClient的所有连接共享一份
+用 TcpServer::setTlsContext / TcpClient::setTlsContext 打开连接上的TLS
+编译时没有找到OpenSSL(cmake -DMYMUDUO_TLS=OFF)时，创建TlsContext会LOG_FATAL
+*/
+class TlsContext : noncopyable
+{
+public:
+    // 服务端: PEM格式的证书链和私钥
+    static std::shared_ptr<TlsContext> newServer(const std::string& certFile,const std::string& keyFile);
+    // 客户端: caFile为空时不校验服务端证书
+    static std::shared_ptr<TlsContext> newClient(const std::string& caFile = std::string());
+
+    // 接管一个已经配置好的SSL_CTX，比如内存里生成的自签名证书
+    TlsContext(SSL_CTX* ctx,bool server);
+    ~TlsContext();
+
+    SSL_CTX* native() const { return ctx_; }
+    bool isServer() const { return server_; }
+
+    /*
+    握手完成后尝试把收发切换到内核TLS(kTLS)，之后的读写就是普通的read/write，由内核加解密
+    只支持TLS1.3的AES-GCM套件，需要内核加载了tls模块；条件不满足时继续由OpenSSL加解密
+    服务端打开后不再发送session ticket(握手之后的ticket会打乱记录序号)
+    */
+    void setKernelTls(bool on);
+    bool kernelTls() const { return kernelTls_; }
+
+private:
+    SSL_CTX* ctx_;
+    bool server_;
+    bool kernelTls_;
+};
+
+using TlsContextPtr = std::shared_ptr<TlsContext>;
@@ -0,0 +1,446 @@
+#include "TlsFilter.h"
+#include "Logger.h"
+
+#ifdef MYMUDUO_TLS
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+// TLS1.3的HKDF-Expand-Label(secret,label,"",outLen)，从流量密钥导出记录层的key和iv
+static bool hkdfExpandLabel(const EVP_MD* md,const std::string& secret,const char* label,
+    unsigned char* out,size_t outLen)
+{
+    unsigned char info[2 + 1 + 255 + 1];
+    size_t labelLen = strlen(label);
+    info[0] = static_cast<unsigned char>(outLen >> 8);
+    info[1] = static_cast<unsigned char>(outLen);
+    info[2] = static_cast<unsigned char>(6 + labelLen);
+    memcpy(info + 3,"tls13 ",6);
+    memcpy(info + 9,label,labelLen);
+    info[9 + labelLen] = 0; //context为空
+    size_t infoLen = 10 + labelLen;
+
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF,nullptr);
+    size_t len = outLen;
+    bool ok = pctx != nullptr
+        && EVP_PKEY_derive_init(pctx) > 0
+        && EVP_PKEY_CTX_set_hkdf_mode(pctx,EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+        && EVP_PKEY_CTX_set_hkdf_md(pctx,md) > 0
+        && EVP_PKEY_CTX_set1_hkdf_key(pctx,
+            reinterpret_cast<const unsigned char*>(secret.data()),static_cast<int>(secret.size())) > 0
+        && EVP_PKEY_CTX_add1_hkdf_info(pctx,info,static_cast<int>(infoLen)) > 0
+        && EVP_PKEY_derive(pctx,out,&len) > 0
+        && len == outLen;
+    EVP_PKEY_CTX_free(pctx);
+    return ok;
+}
+
+static std::string hexDecode(const char* hex)
+{
+    std::string out;
+    for(; hex[0] != '\0' && hex[1] != '\0'; hex += 2)
+    {
+        char byte[3] = { hex[0],hex[1],'\0' };
+        out.push_back(static_cast<char>(strtoul(byte,nullptr,16)));
+    }
+    return out;
+}
+
+void TlsFilter::RecordCounter::feed(const char* data,size_t len)
+{
+    while(len > 0)
+    {
+        if(bodyRemaining > 0)
+        {
+            size_t n = len < bodyRemaining ? len : bodyRemaining;
+            bodyRemaining -= n;
+            data += n;
+            len -= n;
+            if(bodyRemaining == 0)
+            {
+                ++records;
+            }
+            continue;
+        }
+        header[headerBytes++] = static_cast<unsigned char>(*data++);
+        --len;
+        if(headerBytes == sizeof header)
+        {
+            headerBytes = 0;
+            bodyRemaining = (static_cast<size_t>(header[3]) << 8) | header[4];
+            if(bodyRemaining == 0)
+            {
+                ++records;
+            }
+        }
+    }
+}
+
+int TlsFilter::exDataIndex()
+{
+    static int index = SSL_get_ex_new_index(0,nullptr,nullptr,nullptr,nullptr);
+    return index;
+}
+
+TlsFilter::TlsFilter(const TlsContextPtr& ctx,int fd)
+    :ctx_(ctx)
+    ,fd_(fd)
+    ,ssl_(SSL_new(ctx->native()))
+    ,rbio_(BIO_new(BIO_s_mem()))
+    ,wbio_(BIO_new(BIO_s_mem()))
+    ,handshakeDone_(false)
+    ,kernelTls_(ctx->kernelTls())
+    ,ulpEnabled_(false)
+    ,txOffloaded_(false)
+    ,rxOffloaded_(false)
+{
+    if(ssl_ == nullptr || rbio_ == nullptr || wbio_ == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d create SSL failed! \n",__FILE__,__FUNCTION__,__LINE__);
+    }
+    SSL_set_bio(ssl_,rbio_,wbio_); //两个BIO的所有权交给ssl_
+    if(ctx->isServer())
+    {
+        SSL_set_accept_state(ssl_);
+    }
+    else
+    {
+        SSL_set_connect_state(ssl_);
+    }
+    SSL_set_ex_data(ssl_,exDataIndex(),this);
+}
+
+TlsFilter::~TlsFilter()
+{
+    SSL_free(ssl_);
+}
+
+bool TlsFilter::start(std::string* out)
+{
+    return handshake(out);
+}
+
+bool TlsFilter::decrypt(Buffer* plain,std::string* out)
+{
+    if(!feedInput())
+    {
+        return false;
+    }
+    if(!handshakeDone_)
+    {
+        if(!handshake(out))
+        {
+            return false;
+        }
+        if(!handshakeDone_)
+        {
+            return true;
+        }
+    }
+
+    char buf[16384];
+    for(;;)
+    {
+        int n = SSL_read(ssl_,buf,sizeof buf);
+        if(n > 0)
+        {
+            plain->append(buf,n);
+            continue;
+        }
+        int err = SSL_get_error(ssl_,n);
+        if(err == SSL_ERROR_WANT_READ || err == SSL_ERROR_ZERO_RETURN) //密文读完了，或者对端发了close_notify
+        {
+            break;
+        }
+        return fatal(n,"SSL_read");
+    }
+    drainOutput(out); //SSL_read也可能需要回复数据，比如KeyUpdate
+
+    if(kernelTls_ && !rxOffloaded_)
+    {
+        offloadRx();
+    }
+    return true;
+}
+
+bool TlsFilter::encrypt(const char* data,size_t len,std::string* out)
+{
+    if(!handshakeDone_)
+    {
+        pending_.append(data,len);
+        return true;
+    }
+    while(len > 0)
+    {
+        int chunk = len > 0x40000000 ? 0x40000000 : static_cast<int>(len);
+        int n = SSL_write(ssl_,data,chunk);
+        if(n <= 0)
+        {
+            return fatal(n,"SSL_write");
+        }
+        data += n;
+        len -= n;
+    }
+    drainOutput(out);
+    return true;
+}
+
+bool TlsFilter::handshake(std::string* out)
+{
+    int ret = SSL_do_handshake(ssl_);
+    if(ret == 1)
+    {
+        onHandshakeDone(out);
+        return flushPending(out);
+    }
+    drainOutput(out);
+    int err = SSL_get_error(ssl_,ret);
+    if(err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+    {
+        return true;
+    }
+    return fatal(ret,"SSL_do_handshake");
+}
+
+void TlsFilter::onHandshakeDone(std::string* out)
+{
+    drainOutput(out); //握手最后一段，用的是握手密钥，不计入应用记录
+    handshakeDone_ = true;
+    if(!kernelTls_)
+    {
+        return;
+    }
+
+    uint32_t cipher = SSL_CIPHER_get_id(SSL_get_current_cipher(ssl_)) & 0xFFFF;
+    if(SSL_version(ssl_) != TLS1_3_VERSION
+        || (cipher != 0x1301 && cipher != 0x1302) //TLS_AES_128_GCM_SHA256 / TLS_AES_256_GCM_SHA384
+        || clientSecret_.empty() || serverSecret_.empty())
+    {
+        kernelTls_ = false;
+        return;
+    }
+    //rbio_里还没处理的数据已经是握手之后的记录了
+    char* data = nullptr;
+    long len = BIO_get_mem_data(rbio_,&data);
+    if(len > 0)
+    {
+        rxRecords_.feed(data,len);
+    }
+}
+
+bool TlsFilter::flushPending(std::string* out)
+{
+    if(pending_.empty())
+    {
+        return true;
+    }
+    std::string pending;
+    pending.swap(pending_);
+    return encrypt(pending.data(),pending.size(),out);
+}
+
+void TlsFilter::drainOutput(std::string* out)
+{
+    size_t pending = BIO_ctrl_pending(wbio_);
+    if(pending == 0)
+    {
+        return;
+    }
+    size_t old = out->size();
+    out->resize(old + pending);
+    int n = BIO_read(wbio_,&(*out)[old],static_cast<int>(pending));
+    out->resize(old + (n > 0 ? n : 0));
+    if(n > 0 && handshakeDone_ && kernelTls_)
+    {
+        txRecords_.feed(out->data() + old,n);
+    }
+}
+
+bool TlsFilter::feedInput()
+{
+    while(cipherIn_.readableBytes() > 0)
+    {
+        int n = BIO_write(rbio_,cipherIn_.peek(),static_cast<int>(cipherIn_.readableBytes()));
+        if(n <= 0)
+        {
+            LOG_ERROR("TlsFilter::feedInput BIO_write failed \n");
+            return false;
+        }
+        if(handshakeDone_ && kernelTls_)
+        {
+            rxRecords_.feed(cipherIn_.peek(),n);
+        }
+        cipherIn_.retrieve(n);
+    }
+    return true;
+}
+
+void TlsFilter::offloadTx()
+{
+    if(!kernelTls_ || !handshakeDone_ || txOffloaded_ || !txRecords_.aligned())
+    {
+        return;
+    }
+    const std::string& secret = ctx_->isServer() ? serverSecret_ : clientSecret_;
+    if(!enableUlp() || !setKernelKey(TLS_TX,secret,txRecords_.records))
+    {
+        kernelTls_ = false;
+        return;
+    }
+    txOffloaded_ = true;
+    LOG_INFO("TlsFilter::offloadTx fd=%d switched to kTLS at record %llu \n",
+        fd_,(unsigned long long)txRecords_.records);
+}
+
+// 只有socket上读到的数据都已经被OpenSSL处理完，并且停在记录边界上，内核才能接着往下读
+void TlsFilter::offloadRx()
+{
+    if(!handshakeDone_ || cipherIn_.readableBytes() > 0 || BIO_ctrl_pending(rbio_) > 0
+        || SSL_pending(ssl_) > 0 || !rxRecords_.aligned())
+    {
+        return;
+    }
+    const std::string& secret = ctx_->isServer() ? clientSecret_ : serverSecret_;
+    if(!enableUlp() || !setKernelKey(TLS_RX,secret,rxRecords_.records))
+    {
+        kernelTls_ = false;
+        return;
+    }
+    rxOffloaded_ = true;
+    LOG_INFO("TlsFilter::offloadRx fd=%d switched to kTLS at record %llu \n",
+        fd_,(unsigned long long)rxRecords_.records);
+}
+
+bool TlsFilter::enableUlp()
+{
+    if(!ulpEnabled_)
+    {
+        if(::setsockopt(fd_,SOL_TCP,TCP_ULP,"tls",sizeof("tls")) < 0)
+        {
+            return false; //内核没有tls模块
+        }
+        ulpEnabled_ = true;
+    }
+    return true;
+}
+
+bool TlsFilter::setKernelKey(int direction,const std::string& secret,uint64_t seq)
+{
+    uint32_t cipher = SSL_CIPHER_get_id(SSL_get_current_cipher(ssl_)) & 0xFFFF;
+    bool aes128 = cipher == 0x1301;
+    const EVP_MD* md = aes128 ? EVP_sha256() : EVP_sha384();
+    size_t keyLen = aes128 ? 16 : 32;
+
+    unsigned char key[32];
+    unsigned char iv[12];
+    if(!hkdfExpandLabel(md,secret,"key",key,keyLen) || !hkdfExpandLabel(md,secret,"iv",iv,sizeof iv))
+    {
+        LOG_ERROR("TlsFilter::setKernelKey derive key failed \n");
+        return false;
+    }
+    unsigned char recSeq[8];
+    for(int i = 7; i >= 0; --i)
+    {
+        recSeq[i] = static_cast<unsigned char>(seq);
+        seq >>= 8;
+    }
+
+    int ret;
+    //TLS1.3的nonce是12字节的iv，内核结构里拆成4字节salt + 8字节iv
+    if(aes128)
+    {
+        struct tls12_crypto_info_aes_gcm_128 info;
+        memset(&info,0,sizeof info);
+        info.info.version = TLS_1_3_VERSION;
+        info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy(info.salt,iv,sizeof info.salt);
+        memcpy(info.iv,iv + sizeof info.salt,sizeof info.iv);
+        memcpy(info.key,key,sizeof info.key);
+        memcpy(info.rec_seq,recSeq,sizeof info.rec_seq);
+        ret = ::setsockopt(fd_,SOL_TLS,direction,&info,sizeof info);
+    }
+    else
+    {
+        struct tls12_crypto_info_aes_gcm_256 info;
+        memset(&info,0,sizeof info);
+        info.info.version = TLS_1_3_VERSION;
+        info.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        memcpy(info.salt,iv,sizeof info.salt);
+        memcpy(info.iv,iv + sizeof info.salt,sizeof info.iv);
+        memcpy(info.key,key,sizeof info.key);
+        memcpy(info.rec_seq,recSeq,sizeof info.rec_seq);
+        ret = ::setsockopt(fd_,SOL_TLS,direction,&info,sizeof info);
+    }
+    OPENSSL_cleanse(key,sizeof key);
+    if(ret < 0)
+    {
+        LOG_ERROR("TlsFilter::setKernelKey fd=%d direction=%d errno:%d \n",fd_,direction,errno);
+        return false;
+    }
+    return true;
+}
+
+void TlsFilter::onKeyLog(const char* line)
+{
+    const char* secret = strrchr(line,' ');
+    if(secret == nullptr)
+    {
+        return;
+    }
+    if(strncmp(line,"CLIENT_TRAFFIC_SECRET_0 ",24) == 0)
+    {
+        clientSecret_ = hexDecode(secret + 1);
+    }
+    else if(strncmp(line,"SERVER_TRAFFIC_SECRET_0 ",24) == 0)
+    {
+        serverSecret_ = hexDecode(secret + 1);
+    }
+}
+
+bool TlsFilter::fatal(int ret,const char* where)
+{
+    char errBuf[256] = {0}; //不能叫buf，LOG_ERROR宏里有同名的局部变量
+    unsigned long e = ERR_get_error();
+    if(e != 0)
+    {
+        ERR_error_string_n(e,errBuf,sizeof errBuf);
+    }
+    LOG_ERROR("TlsFilter %s fd=%d error:%d %s \n",where,fd_,SSL_get_error(ssl_,ret),errBuf);
+    ERR_clear_error();
+    return false;
+}
+
+#else
+
+// 没有OpenSSL时TlsContext无法创建，下面的函数不会被调用到
+
+TlsFilter::TlsFilter(const TlsContextPtr& ctx,int fd)
+    :ctx_(ctx),fd_(fd),ssl_(nullptr),rbio_(nullptr),wbio_(nullptr)
+    ,handshakeDone_(false),kernelTls_(false),ulpEnabled_(false),txOffloaded_(false),rxOffloaded_(false)
+{
+}
+
+TlsFilter::~TlsFilter() {}
+bool TlsFilter::start(std::string*) { return false; }
+bool TlsFilter::decrypt(Buffer*,std::string*) { return false; }
+bool TlsFilter::encrypt(const char*,size_t,std::string*) { return false; }
+void TlsFilter::offloadTx() {}
+void TlsFilter::onKeyLog(const char*) {}
+int TlsFilter::exDataIndex() { return -1; }
+
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "TlsContext.h"
+
+#include <string>
+#include <stdint.h>
+
+typedef struct ssl_st SSL;
+typedef struct bio_st BIO;
+
+/*
+TcpConnection里的TLS过滤层，OpenSSL工作在非阻塞的内存BIO模式下，不直接碰socket:
+    handleRead:  socket => cipherIn_ => rbio => SSL_read => inputBuffer_
+    send:        明文 => SSL_write => wbio => 密文 => outputBuffer_ => socket
+握手也由handleRead驱动，握手完成之前send的明文先缓存在pending_里
+
+打开kTLS时，握手完成后统计已经用应用密钥加解密过的记录数作为记录序号，
+把密钥交给内核(setsockopt TLS_TX/TLS_RX)，之后这个方向的数据就不再经过OpenSSL
+*/
+class TlsFilter : noncopyable
+{
+public:
+    TlsFilter(const TlsContextPtr& ctx,int fd);
+    ~TlsFilter();
+
+    // 从socket读到的密文先放在这里
+    Buffer* cipherInput() { return &cipherIn_; }
+
+    // 客户端发出ClientHello，需要写给socket的字节追加到out
+    bool start(std::string* out);
+    // 处理cipherIn_里的密文，明文追加到plain，需要写给socket的字节追加到out，返回false表示TLS出错
+    bool decrypt(Buffer* plain,std::string* out);
+    // 加密明文，密文追加到out；握手完成之前先缓存
+    bool encrypt(const char* data,size_t len,std::string* out);
+
+    bool handshakeDone() const { return handshakeDone_; }
+    bool txOffloaded() const { return txOffloaded_; }
+    bool rxOffloaded() const { return rxOffloaded_; }
+
+    // 握手已经完成，之前产生的密文都已经写进socket时调用，满足条件就把发送方向切换到kTLS
+    void offloadTx();
+
+    // SSL_CTX的keylog回调，保存TLS1.3的应用流量密钥
+    void onKeyLog(const char* line);
+    static int exDataIndex();
+
+private:
+    // 按TLS记录头统计完整记录的个数
+    struct RecordCounter
+    {
+        RecordCounter() : headerBytes(0),bodyRemaining(0),records(0) {}
+        void feed(const char* data,size_t len);
+        bool aligned() const { return headerBytes == 0 && bodyRemaining == 0; }
+
+        unsigned char header[5];
+        size_t headerBytes;
+        size_t bodyRemaining;
+        uint64_t records;
+    };
+
+    bool handshake(std::string* out);
+    void onHandshakeDone(std::string* out);
+    bool flushPending(std::string* out);
+    void drainOutput(std::string* out);
+    bool feedInput();
+    void offloadRx();
+    bool setKernelKey(int direction,const std::string& secret,uint64_t seq);
+    bool enableUlp();
+    bool fatal(int ret,const char* where);
+
+    TlsContextPtr ctx_;
+    int fd_;
+    SSL* ssl_;
+    BIO* rbio_;  //OpenSSL从这里读密文
+    BIO* wbio_;  //OpenSSL把密文写到这里
+    Buffer cipherIn_;
+    std::string pending_;  //握手完成之前send的明文
+
+    bool handshakeDone_;
+    bool kernelTls_;       //这个连接还在尝试kTLS
+    bool ulpEnabled_;
+    bool txOffloaded_;
+    bool rxOffloaded_;
+    std::string clientSecret_;
+    std::string serverSecret_;
+    RecordCounter txRecords_;  //握手之后OpenSSL写出的记录
+    RecordCounter rxRecords_;  //握手之后交给OpenSSL的记录
+};
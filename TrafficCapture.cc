@@ -0,0 +1,221 @@
+#include "TrafficCapture.h"
+#include "Thread.h"
+#include "Clock.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+
+const char TrafficCapture::kMagic[8] = {'M','M','C','A','P','0','0','1'};
+const int TrafficCapture::kFlushIntervalSeconds;
+
+namespace
+{
+
+void appendVarint(std::string* out,uint64_t value)
+{
+    char buf[10];
+    size_t n = 0;
+    while(value >= 0x80)
+    {
+        buf[n++] = static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buf[n++] = static_cast<char>(value);
+    out->append(buf,n);
+}
+
+} // namespace
+
+TrafficCapturePtr TrafficCapture::open(const std::string& path,size_t maxFileBytes)
+{
+    FILE* file = ::fopen(path.c_str(),"wbe");
+    if(file == nullptr)
+    {
+        LOG_ERROR("TrafficCapture::open %s failed, errno = %d \n",path.c_str(),errno);
+        return TrafficCapturePtr();
+    }
+    if(::fwrite(kMagic,1,sizeof kMagic,file) != sizeof kMagic)
+    {
+        LOG_ERROR("TrafficCapture::open %s write header failed \n",path.c_str());
+        ::fclose(file);
+        return TrafficCapturePtr();
+    }
+    return TrafficCapturePtr(new TrafficCapture(file,path,maxFileBytes));
+}
+
+TrafficCapture::TrafficCapture(FILE* file,const std::string& path,size_t maxFileBytes)
+    :file_(file)
+    ,path_(path)
+    ,maxFileBytes_(maxFileBytes)
+    ,startNs_(Clock::nowNs())
+    ,recordedBytes_(sizeof kMagic)
+    ,droppedRecords_(0)
+    ,running_(true)
+    ,thread_(new Thread(std::bind(&TrafficCapture::writerLoop,this),"TrafficCapture"))
+{
+    current_.reserve(kBufferSize);
+    thread_->start();
+}
+
+TrafficCapture::~TrafficCapture()
+{
+    stop();
+}
+
+void TrafficCapture::record(CaptureEvent event,uint64_t connId,const void* data,size_t len)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!running_)
+    {
+        return;
+    }
+    //时间戳在锁里取，文件里的记录按时间有序
+    const int64_t timeNs = Clock::nowNs() - startNs_;
+    const size_t header = 1 + 10 + 10 + 10;
+    if((maxFileBytes_ > 0 && recordedBytes_ + header + len > maxFileBytes_)
+        || (current_.size() + header + len > kBufferSize && full_.size() >= kMaxPendingBuffers))
+    {
+        ++droppedRecords_;
+        return;
+    }
+    if(!current_.empty() && current_.size() + header + len > kBufferSize)
+    {
+        full_.push_back(std::string());
+        full_.back().swap(current_);
+        current_.reserve(kBufferSize);
+        cond_.notify_one();
+    }
+    const size_t before = current_.size();
+    current_.push_back(static_cast<char>(event));
+    appendVarint(&current_,connId);
+    appendVarint(&current_,static_cast<uint64_t>(timeNs));
+    appendVarint(&current_,len);
+    current_.append(static_cast<const char*>(data),len);
+    recordedBytes_ += current_.size() - before;
+}
+
+void TrafficCapture::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_->join();
+    ::fclose(file_);
+    file_ = nullptr;
+    LOG_INFO("TrafficCapture::stop %s recorded %llu bytes, dropped %llu records \n",path_.c_str(),
+        static_cast<unsigned long long>(recordedBytes_),static_cast<unsigned long long>(droppedRecords_));
+}
+
+// 满的缓冲区到了就写，不满的每kFlushIntervalSeconds秒也写一次，停止时把剩下的全部写完
+void TrafficCapture::writerLoop()
+{
+    std::vector<std::string> buffers;
+    bool running = true;
+    while(running)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if(full_.empty() && running_)
+            {
+                cond_.wait_for(lock,std::chrono::seconds(kFlushIntervalSeconds));
+            }
+            buffers.swap(full_);
+            if(!current_.empty())
+            {
+                buffers.push_back(std::string());
+                buffers.back().swap(current_);
+            }
+            running = running_;
+        }
+        for(const std::string& buffer : buffers)
+        {
+            if(::fwrite(buffer.data(),1,buffer.size(),file_) != buffer.size())
+            {
+                LOG_ERROR("TrafficCapture::writerLoop write %s failed \n",path_.c_str());
+            }
+        }
+        ::fflush(file_);
+        buffers.clear();
+    }
+}
+
+CaptureReader::CaptureReader(const std::string& path)
+    :file_(::fopen(path.c_str(),"rbe"))
+    ,fileSize_(0)
+{
+    if(file_ != nullptr && ::fseek(file_,0,SEEK_END) == 0)
+    {
+        long size = ::ftell(file_);
+        fileSize_ = size > 0 ? static_cast<uint64_t>(size) : 0;
+        ::rewind(file_);
+    }
+    char magic[sizeof TrafficCapture::kMagic];
+    if(file_ != nullptr && (::fread(magic,1,sizeof magic,file_) != sizeof magic
+        || ::memcmp(magic,TrafficCapture::kMagic,sizeof magic) != 0))
+    {
+        LOG_ERROR("CaptureReader %s is not a capture file \n",path.c_str());
+        ::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+CaptureReader::~CaptureReader()
+{
+    if(file_ != nullptr)
+    {
+        ::fclose(file_);
+    }
+}
+
+bool CaptureReader::readVarint(uint64_t* value)
+{
+    uint64_t result = 0;
+    for(int shift=0;shift<64;shift+=7)
+    {
+        int c = ::getc(file_);
+        if(c == EOF)
+        {
+            return false;
+        }
+        result |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if((c & 0x80) == 0)
+        {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CaptureReader::next(CaptureRecord* record)
+{
+    if(file_ == nullptr)
+    {
+        return false;
+    }
+    int event = ::getc(file_);
+    uint64_t connId,timeNs,len;
+    if(event == EOF || event > kCaptureClose
+        || !readVarint(&connId) || !readVarint(&timeNs) || !readVarint(&len))
+    {
+        return false;
+    }
+    //长度不能超过文件里剩下的字节数，损坏或截断的文件不会导致超大的分配
+    long pos = ::ftell(file_);
+    if(timeNs > static_cast<uint64_t>(INT64_MAX) || pos < 0 || len > fileSize_ - static_cast<uint64_t>(pos))
+    {
+        return false;
+    }
+    record->event = static_cast<CaptureEvent>(event);
+    record->connId = connId;
+    record->timeNs = static_cast<int64_t>(timeNs);
+    record->data.resize(len);
+    return len == 0 || ::fread(&record->data[0],1,len,file_) == len;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Thread;
+
+// 一条记录的类型，方向是从被抓包的这一端看的
+enum CaptureEvent
+{
+    kCaptureOpen = 0,   //连接建立
+    kCaptureIn = 1,     //收到的字节(TLS连接是解密后的明文)
+    kCaptureOut = 2,    //应用交给send的字节
+    kCaptureClose = 3,  //连接关闭
+};
+
+struct CaptureRecord
+{
+    CaptureEvent event;
+    uint64_t connId;
+    int64_t timeNs;     //相对于开始抓包的时刻
+    std::string data;
+};
+
+/*
+把连接上的字节流按时间戳记到文件里，用来在线下重放真实流量(见bench/traffic_replay)
+
+文件开头是8字节的魔数"MMCAP001"，后面一条接一条记录，整数都是LEB128变长编码:
+    | event:1 | connId | timeNs | len | data |
+
+TcpConnection::setTrafficCapture(或者TcpServer::setTrafficCapture)之后，handleRead和发送路径
+把数据拷贝进当前的4MB缓冲区，写满后交给后台线程写文件，loop线程不做文件IO；
+后台线程写不过来(积压超过kMaxPendingBuffers个缓冲区)或者文件达到maxFileBytes时丢弃记录并计数，不阻塞loop
+所有连接共用一把锁，只适合排查问题时临时打开
+*/
+class TrafficCapture : noncopyable
+{
+public:
+    static const char kMagic[8];
+    static const size_t kBufferSize = 4 * 1024 * 1024;
+    static const size_t kMaxPendingBuffers = 16;
+    static const int kFlushIntervalSeconds = 1;
+
+    // 打不开文件时返回nullptr；maxFileBytes为0表示不限
+    static std::shared_ptr<TrafficCapture> open(const std::string& path,size_t maxFileBytes = 0);
+    ~TrafficCapture();
+
+    // 可以在任意线程调用，数据会被拷贝
+    void record(CaptureEvent event,uint64_t connId,const void* data,size_t len);
+    // 写出剩下的数据并关闭文件，之后的record被忽略；析构时也会调用
+    void stop();
+
+    uint64_t recordedBytes() const { return recordedBytes_; }
+    uint64_t droppedRecords() const { return droppedRecords_; }
+
+private:
+    TrafficCapture(FILE* file,const std::string& path,size_t maxFileBytes);
+    void writerLoop();
+
+    FILE* file_;
+    const std::string path_;
+    const size_t maxFileBytes_;
+    const int64_t startNs_;
+    std::atomic<uint64_t> recordedBytes_;  //进入缓冲区的字节数，包括记录头
+    std::atomic<uint64_t> droppedRecords_;
+
+    std::mutex mutex_;  //保护下面几个成员
+    std::condition_variable cond_;
+    std::string current_;
+    std::vector<std::string> full_;
+    bool running_;
+
+    std::unique_ptr<Thread> thread_;
+};
+
+using TrafficCapturePtr = std::shared_ptr<TrafficCapture>;
+
+// 顺序读出抓包文件里的记录
+class CaptureReader : noncopyable
+{
+public:
+    explicit CaptureReader(const std::string& path);
+    ~CaptureReader();
+
+    // 文件打开了并且魔数正确
+    bool valid() const { return file_ != nullptr; }
+    // 读下一条记录，文件结束或者遇到截断、损坏的记录时返回false
+    bool next(CaptureRecord* record);
+
+private:
+    bool readVarint(uint64_t* value);
+
+    FILE* file_;
+    uint64_t fileSize_;
+};
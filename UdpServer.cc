@@ -0,0 +1,48 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+UdpServer::UdpServer(EventLoop *loop,const InetAddress& listenAddr,const std::string& nameArg)
+    :loop_(loop)
+    ,listenAddr_(listenAddr)
+    ,name_(nameArg)
+    ,threadpool_(new EventLoopThreadPool(loop,nameArg))
+    ,batchSize_(64)
+    ,maxDatagramSize_(2048)
+    ,started_(0)
+{
+    if(loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d mainLoop is null! \n",__FILE__,__FUNCTION__,__LINE__);
+    }
+}
+
+UdpServer::~UdpServer()
+{
+    //socket属于各自的loop，在它们自己的线程里停止
+    for(const std::shared_ptr<UdpSocket>& sock : sockets_)
+    {
+        std::shared_ptr<UdpSocket> s(sock);
+        s->getLoop()->runInLoop([s]() { s->stop(); });
+    }
+}
+
+void UdpServer::start()
+{
+    if(started_++ != 0)
+    {
+        return;
+    }
+    threadpool_->start();
+
+    std::vector<EventLoop*> loops = threadpool_->getAllLoops();
+    for(EventLoop *ioLoop : loops)
+    {
+        std::shared_ptr<UdpSocket> sock(new UdpSocket(ioLoop,listenAddr_,true,batchSize_,maxDatagramSize_));
+        sock->setMessageCallback(messageCallback_);
+        sockets_.push_back(sock);
+        ioLoop->runInLoop(std::bind(&UdpSocket::start,sock));
+    }
+    LOG_INFO("UdpServer [%s] started on %s with %lu sockets \n",
+        name_.c_str(),listenAddr_.toIpPort().c_str(),sockets_.size());
+}
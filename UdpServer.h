@@ -0,0 +1,47 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "UdpSocket.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+
+class EventLoop;
+
+/*
+UDP服务器
+每个subloop(没有subloop时就是baseloop)各自创建一个设置了SO_REUSEPORT的UdpSocket绑定到同一个地址，
+内核按四元组把数据报分散到各个socket上，收发都在各自的loop里完成，loop之间没有任何共享状态
+*/
+class UdpServer : noncopyable
+{
+public:
+    UdpServer(EventLoop *loop,const InetAddress& listenAddr,const std::string& nameArg);
+    ~UdpServer();
+
+    void setThreadNum(int numThreads) { threadpool_->setThreadNum(numThreads); }
+    // 回调在收到数据报的那个loop里执行，回复时直接调用参数里的UdpSocket::sendTo
+    void setMessageCallback(const UdpSocket::MessageCallback& cb) { messageCallback_ = cb; }
+    // 每个socket的recvmmsg/sendmmsg批量大小和最大数据报长度，start之前设置
+    void setBatchSize(size_t batchSize) { batchSize_ = batchSize; }
+    void setMaxDatagramSize(size_t size) { maxDatagramSize_ = size; }
+
+    void start();
+
+    const std::string& name() const { return name_; }
+
+private:
+    EventLoop *loop_;
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::shared_ptr<EventLoopThreadPool> threadpool_;
+    UdpSocket::MessageCallback messageCallback_;
+    size_t batchSize_;
+    size_t maxDatagramSize_;
+    std::atomic_int started_;
+    std::vector<std::shared_ptr<UdpSocket>> sockets_;
+};
@@ -0,0 +1,214 @@
+#include "UdpSocket.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static int createNonblockingUdp(sa_family_t family)
+{
+    int sockfd = ::socket(family,SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+    if(sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d udp socket create err:%d \n",__FILE__,__FUNCTION__,__LINE__,errno);
+    }
+    return sockfd;
+}
+
+// 一次可读事件里最多调用recvmmsg的轮数，防止一个socket长时间占住loop
+static const int kMaxRecvRounds = 4;
+
+UdpSocket::UdpSocket(EventLoop *loop,const InetAddress& bindAddr,bool reuseport,
+                     size_t batchSize,size_t maxDatagramSize)
+    :loop_(loop)
+    ,socket_(createNonblockingUdp(bindAddr.family()))
+    ,channel_(loop,socket_.fd())
+    ,batchSize_(batchSize)
+    ,maxDatagramSize_(maxDatagramSize)
+    ,recvBuf_(batchSize * maxDatagramSize)
+    ,recvIov_(batchSize)
+    ,recvAddrs_(batchSize)
+    ,recvMsgs_(batchSize)
+    ,sendBuf_(batchSize * maxDatagramSize)
+    ,sendIov_(batchSize)
+    ,sendAddrs_(batchSize)
+    ,sendMsgs_(batchSize)
+    ,sendHead_(0)
+    ,sendCount_(0)
+    ,flushScheduled_(false)
+    ,lifeToken_(std::make_shared<char>(0))
+    ,dropped_(0)
+{
+    socket_.setReuseAddr(true);
+    //每个subloop一个socket绑定同一个端口，由内核按四元组把数据报分散到各个socket上
+    socket_.setReusePort(reuseport);
+    socket_.bindAddress(bindAddr);
+
+    //接收环和发送槽位的iovec/msghdr只需要初始化一次
+    for(size_t i=0;i<batchSize_;i++)
+    {
+        recvIov_[i].iov_base = &recvBuf_[i * maxDatagramSize_];
+        recvIov_[i].iov_len = maxDatagramSize_;
+        memset(&recvMsgs_[i],0,sizeof(mmsghdr));
+        recvMsgs_[i].msg_hdr.msg_iov = &recvIov_[i];
+        recvMsgs_[i].msg_hdr.msg_iovlen = 1;
+        recvMsgs_[i].msg_hdr.msg_name = &recvAddrs_[i];
+
+        sendIov_[i].iov_base = &sendBuf_[i * maxDatagramSize_];
+        memset(&sendMsgs_[i],0,sizeof(mmsghdr));
+        sendMsgs_[i].msg_hdr.msg_iov = &sendIov_[i];
+        sendMsgs_[i].msg_hdr.msg_iovlen = 1;
+        sendMsgs_[i].msg_hdr.msg_name = &sendAddrs_[i];
+    }
+
+    channel_.setReadCallback(std::bind(&UdpSocket::handleRead,this,std::placeholders::_1));
+    channel_.setWriteCallback(std::bind(&UdpSocket::handleWrite,this));
+}
+
+UdpSocket::~UdpSocket()
+{
+    channel_.disableAll();
+    channel_.remove();
+}
+
+void UdpSocket::start()
+{
+    channel_.enableReading();
+}
+
+void UdpSocket::stop()
+{
+    flush();
+    channel_.disableAll();
+    channel_.remove();
+}
+
+void UdpSocket::handleRead(Timestamp receiveTime)
+{
+    for(int round=0;round<kMaxRecvRounds;round++)
+    {
+        for(size_t i=0;i<batchSize_;i++)
+        {
+            recvMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage); //内核会改写，每次都要重置
+        }
+        int n = ::recvmmsg(socket_.fd(),&recvMsgs_[0],static_cast<unsigned int>(batchSize_),MSG_DONTWAIT,nullptr);
+        if(n < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpSocket::handleRead recvmmsg err:%d \n",errno);
+            }
+            break;
+        }
+        for(int i=0;i<n;i++)
+        {
+            const msghdr& hdr = recvMsgs_[i].msg_hdr;
+            if(hdr.msg_flags & MSG_TRUNC)
+            {
+                LOG_ERROR("UdpSocket::handleRead datagram larger than %lu bytes truncated \n",maxDatagramSize_);
+                continue;
+            }
+            if(messageCallback_)
+            {
+                InetAddress peer((const sockaddr*)&recvAddrs_[i],hdr.msg_namelen);
+                messageCallback_(this,static_cast<const char*>(recvIov_[i].iov_base),recvMsgs_[i].msg_len,peer,receiveTime);
+            }
+        }
+        if(static_cast<size_t>(n) < batchSize_) //已经收空了
+        {
+            break;
+        }
+    }
+}
+
+void UdpSocket::sendTo(const void* data,size_t len,const InetAddress& peer)
+{
+    if(len > maxDatagramSize_)
+    {
+        //大数据报不走槽位，先把排队的发出去保证顺序
+        flush();
+        if(::sendto(socket_.fd(),data,len,0,peer.getSockAddr(),peer.getSockLen()) < 0)
+        {
+            ++dropped_;
+        }
+        return;
+    }
+
+    if(sendCount_ == batchSize_)
+    {
+        flush();
+        if(sendCount_ == batchSize_) //内核发送缓冲区也满了，UDP直接丢弃
+        {
+            ++dropped_;
+            return;
+        }
+    }
+
+    size_t slot = sendCount_++;
+    memcpy(sendIov_[slot].iov_base,data,len);
+    sendIov_[slot].iov_len = len;
+    memcpy(&sendAddrs_[slot],peer.getSockAddr(),peer.getSockLen());
+    sendMsgs_[slot].msg_hdr.msg_namelen = peer.getSockLen();
+    scheduleFlush();
+}
+
+// 本轮loop处理完事件之后统一flush
+void UdpSocket::scheduleFlush()
+{
+    if(!flushScheduled_)
+    {
+        flushScheduled_ = true;
+        std::weak_ptr<char> token(lifeToken_);
+        loop_->queueInLoop([this,token]()
+        {
+            if(token.expired()) //socket已经析构
+            {
+                return;
+            }
+            flushScheduled_ = false;
+            flush();
+        });
+    }
+}
+
+void UdpSocket::flush()
+{
+    while(sendHead_ < sendCount_)
+    {
+        int n = ::sendmmsg(socket_.fd(),&sendMsgs_[sendHead_],static_cast<unsigned int>(sendCount_ - sendHead_),0);
+        if(n < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                //等socket可写之后再继续发
+                if(!channel_.isWriting())
+                {
+                    channel_.enableWriting();
+                }
+                return;
+            }
+            if(errno != EINTR)
+            {
+                //出错的数据报跳过，继续发后面的
+                LOG_ERROR("UdpSocket::flush sendmmsg err:%d \n",errno);
+                ++dropped_;
+                ++sendHead_;
+            }
+            continue;
+        }
+        sendHead_ += n;
+    }
+
+    sendHead_ = 0;
+    sendCount_ = 0;
+    if(channel_.isWriting())
+    {
+        channel_.disableWriting();
+    }
+}
+
+void UdpSocket::handleWrite()
+{
+    flush();
+}
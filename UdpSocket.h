@@ -0,0 +1,79 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <sys/socket.h>
+
+class EventLoop;
+
+/*
+非阻塞的UDP socket，挂在一个EventLoop上
+读: 可读时用recvmmsg一次收取一批数据报，收进预先分配好的消息环里，逐个回调messageCallback_
+写: sendTo把数据报拷进预分配的发送槽位，本轮loop结束时用sendmmsg一次批量发出
+除构造函数外，所有方法(包括析构)都只能在所属loop线程里调用
+*/
+class UdpSocket : noncopyable
+{
+public:
+    // data指向接收环里的内存，只在回调期间有效
+    using MessageCallback = std::function<void(UdpSocket*,const char* data,size_t len,
+                                               const InetAddress& peer,Timestamp receiveTime)>;
+
+    UdpSocket(EventLoop *loop,const InetAddress& bindAddr,bool reuseport,
+              size_t batchSize = 64,size_t maxDatagramSize = 2048);
+    ~UdpSocket();
+
+    void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
+
+    // 开始接收数据报
+    void start();
+    // 停止接收，并把socket从poller中移除；析构时也会移除
+    void stop();
+
+    // 发送一个数据报，超过maxDatagramSize的数据报不经过批量槽位直接发送
+    void sendTo(const void* data,size_t len,const InetAddress& peer);
+    // 立即用sendmmsg发出所有排队的数据报
+    void flush();
+
+    EventLoop* getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+    // 发送槽位已满且内核缓冲区也满时丢弃的数据报个数
+    size_t droppedDatagrams() const { return dropped_; }
+
+private:
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void scheduleFlush();
+
+    EventLoop *loop_;
+    Socket socket_;
+    Channel channel_;
+    const size_t batchSize_;
+    const size_t maxDatagramSize_;
+    MessageCallback messageCallback_;
+
+    // 接收环: batchSize_个槽位，每个槽位maxDatagramSize_字节
+    std::vector<char> recvBuf_;
+    std::vector<iovec> recvIov_;
+    std::vector<sockaddr_storage> recvAddrs_;
+    std::vector<mmsghdr> recvMsgs_;
+
+    // 发送槽位: [sendHead_,sendCount_)是还没发出去的数据报
+    std::vector<char> sendBuf_;
+    std::vector<iovec> sendIov_;
+    std::vector<sockaddr_storage> sendAddrs_;
+    std::vector<mmsghdr> sendMsgs_;
+    size_t sendHead_;
+    size_t sendCount_;
+    bool flushScheduled_;
+    // 排队的flush只持有它的weak_ptr，socket析构后就不再访问this
+    std::shared_ptr<char> lifeToken_;
+    size_t dropped_;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+微基准测试的公共框架
+
+每个用例先预热一轮，然后重复测量kRepeats轮，输出中位数和最小值
+结果以JSON Lines格式写到stdout，一行一个用例，方便脚本对比优化前后的数据:
+{"bench":"buffer.append","param":64,"iters":1000000,"ns_per_op":3.21,"min_ns_per_op":3.10,"ops_per_sec":311526479}
+*/
+namespace bench
+{
+
+const int kRepeats = 5;
+
+inline int64_t nowNs()
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// 防止编译器把被测代码优化掉
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void report(const std::string &name, int64_t param, int64_t iters,
+                   double nsPerOp, double minNsPerOp)
+{
+    printf("{\"bench\":\"%s\",\"param\":%lld,\"iters\":%lld,"
+           "\"ns_per_op\":%.2f,\"min_ns_per_op\":%.2f,\"ops_per_sec\":%.0f}\n",
+           name.c_str(), (long long)param, (long long)iters,
+           nsPerOp, minNsPerOp, nsPerOp > 0 ? 1e9 / nsPerOp : 0.0);
+    fflush(stdout);
+}
+
+// body(iters)执行iters次被测操作，返回实际完成的操作数
+template <typename Body>
+void run(const std::string &name, int64_t param, int64_t iters, Body body)
+{
+    body(iters / 10 + 1); // 预热
+
+    std::vector<double> samples;
+    for (int i = 0; i < kRepeats; ++i)
+    {
+        int64_t start = nowNs();
+        int64_t ops = body(iters);
+        int64_t elapsed = nowNs() - start;
+        samples.push_back(static_cast<double>(elapsed) / (ops > 0 ? ops : 1));
+    }
+    std::sort(samples.begin(), samples.end());
+    report(name, param, iters, samples[samples.size() / 2], samples.front());
+}
+
+// Logger直接写std::cout，基准测试期间把它重定向到/dev/null，保证stdout上只有结果
+class SilenceLogger
+{
+public:
+    SilenceLogger()
+        : null_("/dev/null")
+        , old_(std::cout.rdbuf(null_.rdbuf()))
+    {}
+    ~SilenceLogger() { std::cout.rdbuf(old_); }
+
+private:
+    std::ofstream null_;
+    std::streambuf *old_;
+};
+
+} // namespace bench
@@ -0,0 +1,424 @@
+#include "bench.h"
+
+#include <mymuduo/Buffer.h>
+#include <mymuduo/Channel.h>
+#include <mymuduo/Clock.h>
+#include <mymuduo/ConnectionPool.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/TcpConnection.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+热点结构的组件级微基准:
+    Buffer::append / retrieve / makeSpace / readFd
+    EventLoop::queueInLoop (N个生产者线程)
+    Channel::handleEvent 经过std::function / ChannelHandler的分发
+    EPollPoller::updateChannel / Poller::hasChannel
+    TcpConnection的创建和销毁 (new vs ConnectionPool)
+    Timestamp::now / Clock::nowNs (clock_gettime和TSC)
+    LOG_* 宏
+*/
+
+static void benchBufferAppend()
+{
+    const size_t sizes[] = {16, 256, 4096};
+    for (size_t size : sizes)
+    {
+        std::string data(size, 'x');
+        Buffer buf;
+        bench::run("buffer.append", size, 2000000, [&](int64_t iters) {
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                buf.append(data.data(), data.size());
+                if (buf.readableBytes() >= 1024 * 1024)
+                {
+                    buf.retrieveAll();
+                }
+            }
+            return iters;
+        });
+    }
+}
+
+static void benchBufferRetrieve()
+{
+    const size_t sizes[] = {16, 256, 4096};
+    for (size_t size : sizes)
+    {
+        std::string data(size, 'x');
+        Buffer buf;
+        bench::run("buffer.retrieveAsString", size, 2000000, [&](int64_t iters) {
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                buf.append(data.data(), data.size());
+                std::string s = buf.retrieveAsString(size);
+                bench::doNotOptimize(s);
+            }
+            return iters;
+        });
+    }
+}
+
+static void benchBufferMakeSpace()
+{
+    // 已读空间足够，makeSpace走数据前移的分支
+    {
+        std::string data(800, 'x');
+        Buffer buf;
+        bench::run("buffer.makeSpace.compact", 800, 2000000, [&](int64_t iters) {
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                buf.retrieveAll();
+                buf.append(data.data(), 900);
+                buf.retrieve(800);
+                buf.append(data.data(), 800);
+                bench::doNotOptimize(buf.peek());
+            }
+            return iters;
+        });
+    }
+    // 每次都需要resize底层vector
+    const size_t sizes[] = {4096, 65536};
+    for (size_t size : sizes)
+    {
+        std::string data(size, 'x');
+        bench::run("buffer.makeSpace.grow", size, 200000, [&](int64_t iters) {
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                Buffer buf;
+                buf.append(data.data(), data.size());
+                bench::doNotOptimize(buf.peek());
+            }
+            return iters;
+        });
+    }
+}
+
+// 大流量连接: Buffer以64K为单位一直追加到size，再整个释放；对比malloc和BufferArena的大块存储
+static void benchBufferBulkGrow()
+{
+    const size_t chunk = 65536;
+    std::string data(chunk, 'x');
+    const size_t sizes[] = {4 << 20, 32 << 20};
+    for (size_t size : sizes)
+    {
+        auto body = [&](int64_t iters) {
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                Buffer buf;
+                for (size_t n = 0; n < size; n += chunk)
+                {
+                    buf.append(data.data(), data.size());
+                }
+                bench::doNotOptimize(buf.peek());
+            }
+            return iters;
+        };
+        BufferArena::setThreshold(0);
+        bench::run("buffer.bulkGrow.malloc", size, 200, body);
+        BufferArena::setThreshold(BufferArena::kSuggestedThreshold);
+        bench::run("buffer.bulkGrow.arena", size, 200, body);
+        BufferArena::setThreshold(0);
+    }
+}
+
+// 每次操作包括对端的一次write和本端的一次readFd
+static void benchBufferReadFd()
+{
+    const size_t sizes[] = {64, 4096, 65536};
+    for (size_t size : sizes)
+    {
+        int fds[2];
+        ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        int sndbuf = 1024 * 1024;
+        ::setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+        std::string data(size, 'x');
+        Buffer buf;
+        bench::run("buffer.readFd", size, 100000, [&](int64_t iters) {
+            int savedErrno = 0;
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                ::write(fds[1], data.data(), data.size());
+                size_t got = 0;
+                while (got < size)
+                {
+                    ssize_t n = buf.readFd(fds[0], &savedErrno);
+                    if (n <= 0)
+                    {
+                        break;
+                    }
+                    got += n;
+                }
+                buf.retrieveAll();
+            }
+            return iters;
+        });
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+}
+
+static void benchQueueInLoop()
+{
+    const int producers[] = {1, 2, 4, 8};
+    for (int n : producers)
+    {
+        EventLoopThread loopThread;
+        EventLoop *loop = loopThread.startLoop();
+        std::atomic<int64_t> executed(0);
+
+        bench::run("eventloop.queueInLoop", n, 400000, [&](int64_t iters) {
+            int64_t perProducer = iters / n;
+            int64_t total = perProducer * n;
+            executed = 0;
+            std::vector<std::thread> threads;
+            for (int p = 0; p < n; ++p)
+            {
+                threads.emplace_back([&]() {
+                    for (int64_t i = 0; i < perProducer; ++i)
+                    {
+                        loop->queueInLoop([&executed]() { ++executed; });
+                    }
+                });
+            }
+            for (std::thread &t : threads)
+            {
+                t.join();
+            }
+            while (executed.load() < total)
+            {
+                std::this_thread::yield();
+            }
+            return total;
+        });
+    }
+}
+
+static int64_t g_dispatched = 0;
+static void onChannelRead(Timestamp) { ++g_dispatched; }
+
+// TcpConnection的分发方式: 虚函数直接调用，不经过std::function，也不lock tie
+class CountingHandler : public ChannelHandler
+{
+public:
+    void onChannelRead(Timestamp) override { ++g_dispatched; }
+    void onChannelWrite() override {}
+    void onChannelClose() override {}
+    void onChannelError() override {}
+};
+
+static void benchChannelDispatch(EventLoop *loop)
+{
+    {
+        Channel channel(loop, -1);
+        channel.setReadCallback(std::bind(&onChannelRead, std::placeholders::_1));
+        channel.set_revents(EPOLLIN);
+        Timestamp now(Timestamp::now());
+        bench::run("channel.handleEvent", 0, 10000000, [&](int64_t iters) {
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                channel.handleEvent(now);
+            }
+            return iters;
+        });
+    }
+    // tie到一个对象上的Channel，每次分发都要lock一次weak_ptr
+    {
+        Channel channel(loop, -1);
+        std::shared_ptr<int> owner(new int(0));
+        channel.tie(owner);
+        channel.setReadCallback(std::bind(&onChannelRead, std::placeholders::_1));
+        channel.set_revents(EPOLLIN);
+        Timestamp now(Timestamp::now());
+        bench::run("channel.handleEvent.tied", 0, 10000000, [&](int64_t iters) {
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                channel.handleEvent(now);
+            }
+            return iters;
+        });
+    }
+    {
+        Channel channel(loop, -1);
+        CountingHandler handler;
+        channel.setHandler(&handler);
+        channel.set_revents(EPOLLIN);
+        Timestamp now(Timestamp::now());
+        bench::run("channel.handleEvent.handler", 0, 10000000, [&](int64_t iters) {
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                channel.handleEvent(now);
+            }
+            return iters;
+        });
+    }
+    bench::doNotOptimize(g_dispatched);
+}
+
+// 交替注册/注销EPOLLOUT，每次都是一次EPollPoller::updateChannel(EPOLL_CTL_MOD)
+static void benchUpdateChannel(EventLoop *loop)
+{
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel channel(loop, fd);
+    channel.enableReading();
+    bench::run("epollpoller.updateChannel", 0, 500000, [&](int64_t iters) {
+        for (int64_t i = 0; i < iters; ++i)
+        {
+            if (i & 1)
+            {
+                channel.disableWriting();
+            }
+            else
+            {
+                channel.enableWriting();
+            }
+        }
+        return iters;
+    });
+    channel.disableAll();
+    channel.remove();
+    ::close(fd);
+}
+
+// N个已注册的channel上轮流查询，EventLoop::hasChannel每次都查一遍Poller::channels_
+static void benchHasChannel(EventLoop *loop)
+{
+    const size_t counts[] = {16, 1024};
+    for (size_t count : counts)
+    {
+        std::vector<int> fds;
+        std::vector<std::unique_ptr<Channel>> channels;
+        for (size_t i = 0; i < count; ++i)
+        {
+            fds.push_back(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+            channels.emplace_back(new Channel(loop, fds.back()));
+            channels.back()->enableReading();
+        }
+        bench::run("epollpoller.hasChannel", count, 10000000, [&](int64_t iters) {
+            int64_t found = 0;
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                found += loop->hasChannel(channels[i % count].get());
+            }
+            bench::doNotOptimize(found);
+            return iters;
+        });
+        for (size_t i = 0; i < count; ++i)
+        {
+            channels[i]->disableAll();
+            channels[i]->remove();
+            ::close(fds[i]);
+        }
+    }
+}
+
+// 每次创建一个连接对象再释放，fd用-1，Socket的setsockopt/close直接失败返回
+static void benchConnectionCreate(EventLoop *loop)
+{
+    std::shared_ptr<const std::string> prefix = std::make_shared<const std::string>("bench");
+    InetAddress addr(8000);
+    bench::run("connection.create.new", 0, 200000, [&](int64_t iters) {
+        for (int64_t i = 0; i < iters; ++i)
+        {
+            TcpConnectionPtr conn(new TcpConnection(loop, i, prefix, -1, addr, addr));
+            bench::doNotOptimize(conn);
+        }
+        return iters;
+    });
+    bench::run("connection.create.pool", 0, 200000, [&](int64_t iters) {
+        for (int64_t i = 0; i < iters; ++i)
+        {
+            TcpConnectionPtr conn(loop->connectionPool()->create(loop, i, prefix, -1, addr, addr));
+            bench::doNotOptimize(conn);
+        }
+        return iters;
+    });
+}
+
+static void benchClock()
+{
+    bench::run("clock.timestamp.now", 0, 10000000, [&](int64_t iters) {
+        for (int64_t i = 0; i < iters; ++i)
+        {
+            bench::doNotOptimize(Timestamp::now());
+        }
+        return iters;
+    });
+    bench::run("clock.monotonicNs", 0, 10000000, [&](int64_t iters) {
+        for (int64_t i = 0; i < iters; ++i)
+        {
+            bench::doNotOptimize(Clock::monotonicNs());
+        }
+        return iters;
+    });
+    if (Clock::enableTsc())
+    {
+        bench::run("clock.nowNs.tsc", 0, 10000000, [&](int64_t iters) {
+            for (int64_t i = 0; i < iters; ++i)
+            {
+                bench::doNotOptimize(Clock::nowNs());
+            }
+            return iters;
+        });
+        Clock::disableTsc();
+    }
+}
+
+static void benchLogger()
+{
+    bench::run("logger.LOG_INFO", 0, 1000000, [&](int64_t iters) {
+        for (int64_t i = 0; i < iters; ++i)
+        {
+            LOG_INFO("bench message %lld from %s", (long long)i, "microbench");
+        }
+        return iters;
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    // 可选参数: 只运行名字以该前缀开头的一组用例，如 ./microbench buffer
+    std::string filter = argc > 1 ? argv[1] : "";
+    bench::SilenceLogger silence;
+    EventLoop loop;
+
+    struct Case
+    {
+        const char *group;
+        std::function<void()> fn;
+    } cases[] = {
+        {"buffer", benchBufferAppend},
+        {"buffer", benchBufferRetrieve},
+        {"buffer", benchBufferMakeSpace},
+        {"buffer", benchBufferReadFd},
+        {"buffer", benchBufferBulkGrow},
+        {"eventloop", benchQueueInLoop},
+        {"channel", std::bind(benchChannelDispatch, &loop)},
+        {"epollpoller", std::bind(benchUpdateChannel, &loop)},
+        {"epollpoller", std::bind(benchHasChannel, &loop)},
+        {"connection", std::bind(benchConnectionCreate, &loop)},
+        {"clock", benchClock},
+        {"logger", benchLogger},
+    };
+
+    for (const Case &c : cases)
+    {
+        if (std::string(c.group).compare(0, filter.size(), filter) == 0)
+        {
+            c.fn();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,323 @@
+#include "bench.h"
+
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/InetAddress.h>
+#include <mymuduo/RespCodec.h>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+RESP协议的压测客户端，参数和redis-benchmark一致，可以拿同一条命令行对比example/kvserver和真正的redis:
+    ./resp_bench [-h host] [-p port] [-c clients] [-n requests] [-d size] [-P pipeline] [-r keyspace]
+                 [-t ping_inline,ping_mbulk,set,get,incr] [--threads N]
+和redis-benchmark一样: 每个连接一次发出P条命令，P条回复都收到之后再发下一批；
+-r指定时key是key:后跟12位随机数，否则所有请求都用key:__rand_int__
+每个测试输出一行JSON: 每秒请求数，以及每条请求从发出到收到回复的延迟分位数(毫秒)
+看吞吐随核数的变化时，用不同的IO线程数启动服务端(./kvserver N)，再用同样的参数压测
+*/
+
+struct Options
+{
+    Options()
+        :host("127.0.0.1"),port(6380),clients(50),requests(100000),dataSize(3),
+         pipeline(1),keyspace(0),threads(1),tests("ping_inline,ping_mbulk,set,get,incr")
+    {}
+
+    std::string host;
+    int port;
+    int clients;
+    int64_t requests;
+    int dataSize;
+    int pipeline;
+    int64_t keyspace;
+    int threads;
+    std::string tests;
+};
+
+// 所有连接共享的进度
+struct Run
+{
+    Run(const Options& o,const std::string& t) : options(o),test(t),issued(0),errors(0),finished(0) {}
+
+    const Options& options;
+    const std::string test;
+    std::atomic<int64_t> issued;    //已经领走的请求数
+    std::atomic<int64_t> errors;
+    std::atomic<int> finished;      //已经结束的连接数
+    std::promise<void> done;
+};
+
+class BenchClient
+{
+public:
+    BenchClient(EventLoop* loop,const InetAddress& addr,Run* run,uint32_t seed)
+        :client_(loop,addr,"RespBench")
+        ,run_(run)
+        ,random_(seed)
+        ,value_(run->options.dataSize,'x')
+        ,inflight_(0)
+        ,batch_(0)
+        ,sentNs_(0)
+        ,finished_(false)
+    {
+        client_.setConnectionCallback([this](const TcpConnectionPtr& conn)
+        {
+            if(conn->connected())
+            {
+                sendBatch(conn);
+            }
+            else if(!finished_)
+            {
+                fprintf(stderr,"connection to server lost\n");
+                ::exit(1);
+            }
+        });
+        client_.setMessageCallback([this](const TcpConnectionPtr& conn,Buffer* buf,Timestamp)
+        {
+            onMessage(conn,buf);
+        });
+        latencies_.reserve(run->options.requests / run->options.clients + 1);
+    }
+
+    void start() { client_.connect(); }
+    const std::vector<int64_t>& latencies() const { return latencies_; }
+
+private:
+    // 领P条请求一次发出去，请求都领完了就结束这个连接
+    void sendBatch(const TcpConnectionPtr& conn)
+    {
+        const int64_t pipeline = run_->options.pipeline;
+        int64_t first = run_->issued.fetch_add(pipeline);
+        int64_t count = std::min(pipeline,run_->options.requests - first);
+        if(count <= 0)
+        {
+            finished_ = true;
+            if(++run_->finished == run_->options.clients)
+            {
+                run_->done.set_value();
+            }
+            return;
+        }
+        out_.retrieveAll();
+        for(int64_t i=0;i<count;i++)
+        {
+            appendRequest();
+        }
+        inflight_ = static_cast<int>(count);
+        batch_ = inflight_;
+        sentNs_ = bench::nowNs();
+        conn->send(out_.peek(),out_.readableBytes());
+    }
+
+    void appendRequest()
+    {
+        const std::string& test = run_->test;
+        if(test == "ping_inline")
+        {
+            out_.append("PING\r\n",6);
+            return;
+        }
+        args_.clear();
+        if(test == "ping_mbulk")
+        {
+            args_.push_back(RespSlice("PING",4));
+        }
+        else
+        {
+            if(run_->options.keyspace > 0)
+            {
+                ::snprintf(key_,sizeof key_,"key:%012lld",
+                    static_cast<long long>(random_() % run_->options.keyspace));
+            }
+            else
+            {
+                ::snprintf(key_,sizeof key_,"key:__rand_int__");
+            }
+            if(test == "set")
+            {
+                args_.push_back(RespSlice("SET",3));
+                args_.push_back(RespSlice(key_,::strlen(key_)));
+                args_.push_back(RespSlice(value_.data(),value_.size()));
+            }
+            else if(test == "get")
+            {
+                args_.push_back(RespSlice("GET",3));
+                args_.push_back(RespSlice(key_,::strlen(key_)));
+            }
+            else
+            {
+                args_.push_back(RespSlice("INCR",4));
+                args_.push_back(RespSlice("counter:__rand_int__",20));
+            }
+        }
+        RespCodec::appendCommand(&out_,args_);
+    }
+
+    void onMessage(const TcpConnectionPtr& conn,Buffer* buf)
+    {
+        RespReply reply;
+        size_t consumed = 0;
+        int ret = 0;
+        while(inflight_ > 0 && (ret = RespCodec::parseReply(buf,&reply,&consumed)) > 0)
+        {
+            if(reply.type == '-')
+            {
+                ++run_->errors;
+            }
+            buf->retrieve(consumed);
+            --inflight_;
+        }
+        if(ret < 0)
+        {
+            fprintf(stderr,"protocol error\n");
+            ::abort();
+        }
+        if(inflight_ == 0)
+        {
+            //一批里的请求是同时发出的，延迟都按整批的往返算，和redis-benchmark一样
+            int64_t latency = bench::nowNs() - sentNs_;
+            for(int i=0;i<batch_;i++)
+            {
+                latencies_.push_back(latency);
+            }
+            sendBatch(conn);
+        }
+    }
+
+    TcpClient client_;
+    Run* run_;
+    std::minstd_rand random_;
+    const std::string value_;
+    Buffer out_;
+    std::vector<RespSlice> args_;
+    char key_[32];
+    int inflight_;      //这一批还没收到的回复数
+    int batch_;
+    int64_t sentNs_;
+    bool finished_;
+    std::vector<int64_t> latencies_;
+};
+
+// 在loop线程里执行func并等它完成
+template <typename Func>
+static void runAndWait(EventLoop* loop,Func func)
+{
+    std::promise<void> done;
+    loop->runInLoop([&]() { func(); done.set_value(); });
+    done.get_future().wait();
+}
+
+static double percentileMs(const std::vector<int64_t>& sorted,double p)
+{
+    if(sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1,static_cast<size_t>(sorted.size() * p));
+    return sorted[index] / 1e6;
+}
+
+static void runTest(const Options& options,const std::string& test,const std::vector<EventLoop*>& loops)
+{
+    Run run(options,test);
+    InetAddress addr(static_cast<uint16_t>(options.port),options.host);
+    std::vector<std::unique_ptr<BenchClient>> clients(options.clients);
+
+    int64_t start = bench::nowNs();
+    for(int i=0;i<options.clients;i++)
+    {
+        EventLoop* loop = loops[i % loops.size()];
+        runAndWait(loop,[&,i]()
+        {
+            clients[i].reset(new BenchClient(loop,addr,&run,static_cast<uint32_t>(i + 1)));
+            clients[i]->start();
+        });
+    }
+    run.done.get_future().wait();
+    int64_t elapsed = bench::nowNs() - start;
+
+    std::vector<int64_t> all;
+    for(int i=0;i<options.clients;i++)
+    {
+        runAndWait(loops[i % loops.size()],[&,i]()
+        {
+            all.insert(all.end(),clients[i]->latencies().begin(),clients[i]->latencies().end());
+            clients[i].reset();
+        });
+    }
+    std::sort(all.begin(),all.end());
+    printf("{\"bench\":\"resp.%s\",\"clients\":%d,\"pipeline\":%d,\"data_size\":%d,\"requests\":%zu,\"errors\":%lld,"
+           "\"ops_per_sec\":%.0f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f}\n",
+           test.c_str(),options.clients,options.pipeline,options.dataSize,all.size(),(long long)run.errors.load(),
+           all.size() * 1e9 / elapsed,percentileMs(all,0.5),percentileMs(all,0.99),percentileMs(all,0.999));
+    fflush(stdout);
+}
+
+int main(int argc,char *argv[])
+{
+    Options options;
+    for(int i=1;i+1<argc;i+=2)
+    {
+        std::string flag = argv[i];
+        const char* value = argv[i + 1];
+        if(flag == "-h") options.host = value;
+        else if(flag == "-p") options.port = atoi(value);
+        else if(flag == "-c") options.clients = atoi(value);
+        else if(flag == "-n") options.requests = atoll(value);
+        else if(flag == "-d") options.dataSize = atoi(value);
+        else if(flag == "-P") options.pipeline = atoi(value);
+        else if(flag == "-r") options.keyspace = atoll(value);
+        else if(flag == "-t") options.tests = value;
+        else if(flag == "--threads") options.threads = atoi(value);
+        else
+        {
+            fprintf(stderr,"unknown option %s\n",flag.c_str());
+            return 1;
+        }
+    }
+    options.clients = std::max(options.clients,1);
+    options.pipeline = std::max(options.pipeline,1);
+    options.threads = std::max(options.threads,1);
+    bench::SilenceLogger silence;
+
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<EventLoop*> loops;
+    for(int i=0;i<options.threads;i++)
+    {
+        threads.emplace_back(new EventLoopThread());
+        loops.push_back(threads.back()->startLoop());
+    }
+
+    std::string tests = options.tests + ",";
+    size_t begin = 0;
+    size_t comma;
+    while((comma = tests.find(',',begin)) != std::string::npos)
+    {
+        std::string test = tests.substr(begin,comma - begin);
+        begin = comma + 1;
+        if(test == "ping")
+        {
+            runTest(options,"ping_inline",loops);
+            runTest(options,"ping_mbulk",loops);
+        }
+        else if(test == "ping_inline" || test == "ping_mbulk" || test == "set" || test == "get" || test == "incr")
+        {
+            runTest(options,test,loops);
+        }
+        else if(!test.empty())
+        {
+            fprintf(stderr,"unknown test %s\n",test.c_str());
+        }
+    }
+    return 0;
+}
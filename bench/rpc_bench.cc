@@ -0,0 +1,170 @@
+#include "bench.h"
+
+#include <mymuduo/RpcServer.h>
+#include <mymuduo/RpcClient.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/InetAddress.h>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+/*
+回环上的RPC回显压测:
+    服务端注册一个回显方法，C个客户端连接各自跑在一个loop线程里，
+    每个连接始终保持W个未完成的调用(一个响应回来就立刻发下一个)，持续D秒
+输出一行JSON: 每秒完成的调用数和调用延迟的p50/p99/p999(微秒)
+用法: ./rpc_bench [连接数] [每连接并发W] [服务端线程数] [秒数] [请求字节数]
+*/
+
+static const uint16_t kEchoMethod = 1;
+
+class Driver
+{
+public:
+    Driver(EventLoop* loop,const InetAddress& addr,int window,size_t size)
+        :client_(loop,addr,"RpcBench")
+        ,window_(window)
+        ,payload_(size,'x')
+        ,running_(true)
+        ,errors_(0)
+    {
+        client_.setConnectionCallback([this](const TcpConnectionPtr& conn)
+        {
+            if(conn->connected())
+            {
+                for(int i=0;i<window_;i++)
+                {
+                    issue();
+                }
+            }
+        });
+        latencies_.reserve(1 << 20);
+    }
+
+    void start() { client_.connect(); }
+    void stop() { running_ = false; }
+
+    const std::vector<int64_t>& latencies() const { return latencies_; }
+    int64_t errors() const { return errors_; }
+
+private:
+    void issue()
+    {
+        int64_t start = bench::nowNs();
+        client_.call(kEchoMethod,payload_.data(),payload_.size(),
+            [this,start](RpcStatus status,const char*,size_t)
+            {
+                if(status != kRpcOk)
+                {
+                    ++errors_;
+                    return;
+                }
+                latencies_.push_back(bench::nowNs() - start);
+                if(running_)
+                {
+                    issue();
+                }
+            });
+    }
+
+    RpcClient client_;
+    const int window_;
+    const std::string payload_;
+    bool running_;                  //以下只在客户端loop线程里访问
+    int64_t errors_;
+    std::vector<int64_t> latencies_;
+};
+
+// 在loop线程里执行func并等它完成
+template <typename Func>
+static void runAndWait(EventLoop* loop,Func func)
+{
+    std::promise<void> done;
+    loop->runInLoop([&]() { func(); done.set_value(); });
+    done.get_future().wait();
+}
+
+static double percentileUs(const std::vector<int64_t>& sorted,double p)
+{
+    if(sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1,static_cast<size_t>(sorted.size() * p));
+    return sorted[index] / 1000.0;
+}
+
+int main(int argc,char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 4;
+    int window = argc > 2 ? atoi(argv[2]) : 16;
+    int serverThreads = argc > 3 ? atoi(argv[3]) : 2;
+    double seconds = argc > 4 ? atof(argv[4]) : 3;
+    size_t size = argc > 5 ? atoi(argv[5]) : 64;
+    bench::SilenceLogger silence;
+
+    InetAddress addr(19778,"127.0.0.1");
+    EventLoopThread serverThread;
+    EventLoop* serverLoop = serverThread.startLoop();
+    std::unique_ptr<RpcServer> server;
+    runAndWait(serverLoop,[&]()
+    {
+        server.reset(new RpcServer(serverLoop,addr,"RpcBench"));
+        server->setThreadNum(serverThreads);
+        server->registerMethod(kEchoMethod,[](const RpcCall& call) { call.reply(call.data(),call.size()); });
+        server->start();
+    });
+
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<EventLoop*> loops;
+    std::vector<std::unique_ptr<Driver>> drivers(connections);
+    for(int i=0;i<connections;i++)
+    {
+        threads.emplace_back(new EventLoopThread());
+        loops.push_back(threads.back()->startLoop());
+    }
+
+    int64_t start = bench::nowNs();
+    for(int i=0;i<connections;i++)
+    {
+        runAndWait(loops[i],[&,i]()
+        {
+            drivers[i].reset(new Driver(loops[i],addr,window,size));
+            drivers[i]->start();
+        });
+    }
+    ::usleep(static_cast<useconds_t>(seconds * 1e6));
+    for(int i=0;i<connections;i++)
+    {
+        runAndWait(loops[i],[&,i]() { drivers[i]->stop(); });
+    }
+    int64_t elapsed = bench::nowNs() - start;
+    ::usleep(100 * 1000); //等在途的调用回来
+
+    std::vector<int64_t> all;
+    int64_t errors = 0;
+    for(int i=0;i<connections;i++)
+    {
+        runAndWait(loops[i],[&,i]()
+        {
+            all.insert(all.end(),drivers[i]->latencies().begin(),drivers[i]->latencies().end());
+            errors += drivers[i]->errors();
+            drivers[i].reset();
+        });
+    }
+    ::usleep(100 * 1000); //等服务端处理完这些连接的关闭，再析构RpcServer
+    runAndWait(serverLoop,[&]() { server.reset(); });
+
+    std::sort(all.begin(),all.end());
+    printf("{\"bench\":\"rpc.echo\",\"param\":%zu,\"connections\":%d,\"window\":%d,\"calls\":%zu,\"errors\":%lld,"
+           "\"calls_per_sec\":%.0f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f}\n",
+           size,connections,window,all.size(),(long long)errors,
+           all.size() * 1e9 / elapsed,percentileUs(all,0.5),percentileUs(all,0.99),percentileUs(all,0.999));
+    return 0;
+}
@@ -0,0 +1,223 @@
+#include "bench.h"
+
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/InetAddress.h>
+#include <mymuduo/TlsContext.h>
+
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/x509.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+回环上的TLS服务端性能:
+    tls.handshake     每次新建连接完成一次完整握手，ns_per_op是所有客户端合计的每次握手耗时
+    tls.pingpong.*    C个连接各做R次S字节的回显，ops_per_sec*S就是回显吞吐
+.ktls结尾的用例打开了TlsContext::setKernelTls，内核不支持时和普通用例走同一条路径
+客户端是阻塞IO的OpenSSL，证书是启动时在内存里生成的自签名EC证书
+用法: ./tls_bench [连接数] [服务端线程数]
+*/
+
+static SSL_CTX* newServerCtx()
+{
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC,nullptr);
+    EVP_PKEY_keygen_init(pctx);
+    EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx,NID_X9_62_prime256v1);
+    EVP_PKEY_keygen(pctx,&key);
+    EVP_PKEY_CTX_free(pctx);
+
+    X509* cert = X509_new();
+    X509_set_version(cert,2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert),1);
+    X509_gmtime_adj(X509_getm_notBefore(cert),0);
+    X509_gmtime_adj(X509_getm_notAfter(cert),86400);
+    X509_set_pubkey(cert,key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name,"CN",MBSTRING_ASC,(const unsigned char*)"localhost",-1,-1,0);
+    X509_set_issuer_name(cert,name);
+    X509_sign(cert,key,EVP_sha256());
+
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_use_certificate(ctx,cert);
+    SSL_CTX_use_PrivateKey(ctx,key);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ctx;
+}
+
+// 阻塞的TLS客户端连接，失败返回nullptr
+static SSL* connectTls(SSL_CTX* ctx,const InetAddress &addr)
+{
+    int fd = ::socket(addr.family(),SOCK_STREAM | SOCK_CLOEXEC,0);
+    if(::connect(fd,addr.getSockAddr(),addr.getSockLen()) < 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl,fd);
+    if(SSL_connect(ssl) != 1)
+    {
+        SSL_free(ssl);
+        ::close(fd);
+        return nullptr;
+    }
+    return ssl;
+}
+
+static void closeTls(SSL* ssl)
+{
+    int fd = SSL_get_fd(ssl);
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    ::close(fd);
+}
+
+static bool writeAll(SSL* ssl,const char *data,size_t len)
+{
+    while(len > 0)
+    {
+        int n = SSL_write(ssl,data,static_cast<int>(len));
+        if(n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool readAll(SSL* ssl,char *data,size_t len)
+{
+    while(len > 0)
+    {
+        int n = SSL_read(ssl,data,static_cast<int>(len));
+        if(n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void runHandshakes(SSL_CTX* ctx,const InetAddress &addr,int connections,int64_t perConn)
+{
+    std::vector<std::thread> threads;
+    for(int c=0;c<connections;c++)
+    {
+        threads.emplace_back([&]()
+        {
+            for(int64_t i=0;i<perConn;i++)
+            {
+                SSL* ssl = connectTls(ctx,addr);
+                if(ssl == nullptr)
+                {
+                    break;
+                }
+                closeTls(ssl);
+            }
+        });
+    }
+    for(std::thread &t : threads)
+    {
+        t.join();
+    }
+}
+
+static void runPingPong(SSL_CTX* ctx,const InetAddress &addr,int connections,size_t msgSize,int64_t roundTrips)
+{
+    std::vector<std::thread> threads;
+    for(int c=0;c<connections;c++)
+    {
+        threads.emplace_back([&]()
+        {
+            SSL* ssl = connectTls(ctx,addr);
+            if(ssl == nullptr)
+            {
+                return;
+            }
+            std::string msg(msgSize,'x');
+            std::string reply(msgSize,'\0');
+            for(int64_t i=0;i<roundTrips;i++)
+            {
+                if(!writeAll(ssl,msg.data(),msg.size()) || !readAll(ssl,&reply[0],reply.size()))
+                {
+                    break;
+                }
+            }
+            closeTls(ssl);
+        });
+    }
+    for(std::thread &t : threads)
+    {
+        t.join();
+    }
+}
+
+static void benchTls(const std::string &suffix,bool kernelTls,const InetAddress &addr,int connections,int serverThreads)
+{
+    EventLoop loop;
+    TcpServer server(&loop,addr,"tls_bench");
+    TlsContextPtr serverCtx = std::make_shared<TlsContext>(newServerCtx(),true);
+    serverCtx->setKernelTls(kernelTls);
+    server.setTlsContext(serverCtx);
+    server.setThreadNum(serverThreads);
+    server.setMessageCallback([](const TcpConnectionPtr &conn,Buffer *buf,Timestamp)
+    {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+
+    std::thread client([&]()
+    {
+        SSL_CTX* clientCtx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_session_cache_mode(clientCtx,SSL_SESS_CACHE_OFF);
+
+        bench::run("tls.handshake" + suffix,connections,200 * connections,
+            [&](int64_t iters)
+            {
+                int64_t perConn = iters / connections;
+                runHandshakes(clientCtx,addr,connections,perConn);
+                return perConn * connections;
+            });
+
+        const size_t sizes[] = {64,4096,65536};
+        for(size_t size : sizes)
+        {
+            int64_t roundTrips = size >= 65536 ? 1000 : 10000;
+            bench::run("tls.pingpong" + suffix,size,roundTrips * connections,
+                [&](int64_t iters)
+                {
+                    int64_t perConn = iters / connections;
+                    runPingPong(clientCtx,addr,connections,size,perConn);
+                    return perConn * connections;
+                });
+        }
+        SSL_CTX_free(clientCtx);
+        loop.runInLoop([&loop]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+}
+
+int main(int argc,char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 4;
+    int serverThreads = argc > 2 ? atoi(argv[2]) : 2;
+    bench::SilenceLogger silence;
+
+    benchTls("",false,InetAddress(19778,"127.0.0.1"),connections,serverThreads);
+    benchTls(".ktls",true,InetAddress(19779,"127.0.0.1"),connections,serverThreads);
+    return 0;
+}
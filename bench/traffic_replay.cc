@@ -0,0 +1,391 @@
+#include "bench.h"
+
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/InetAddress.h>
+#include <mymuduo/TrafficCapture.h>
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+/*
+重放TrafficCapture抓下来的流量:
+    ./traffic_replay <抓包文件> [-h host] [-p port] [-c 连接数] [-s 倍速] [--threads N] [--timeout 秒]
+抓包文件里每个连接收到的字节流(kCaptureIn)按原来的时间间隔重新发给服务端，-s 2表示两倍速，
+-s 0表示不等时间间隔，上一个请求的响应收齐了就发下一个；-c大于抓到的连接数时循环复用这些连接的流量
+
+响应按字节数对齐: 抓包里服务端在两次收到数据之间发了多少字节，重放时就等同样多的字节，
+从发出一段数据到收齐它对应的响应就是一次请求的延迟；服务端状态和抓包时不同、响应长度变了的话延迟会对不齐
+输出一行JSON: 请求数、收发字节数、没能完成的连接数和延迟分位数(毫秒)
+*/
+
+struct Chunk
+{
+    int64_t offsetNs;   //相对于连接建立的时间
+    std::string data;
+    size_t expected;    //抓包时这段数据之后、下一段之前服务端发出的字节数
+};
+
+struct Stream
+{
+    Stream() : greeting(0) {}
+
+    std::vector<Chunk> chunks;
+    size_t greeting;    //第一段数据之前服务端就发出的字节数
+};
+
+struct Options
+{
+    Options() : host("127.0.0.1"),port(6380),connections(0),speed(1),threads(1),timeout(60) {}
+
+    std::string path;
+    std::string host;
+    int port;
+    int connections;    //0表示和抓包里的连接数一样
+    double speed;
+    int threads;
+    double timeout;
+};
+
+// 所有连接共享的进度
+struct Replay
+{
+    Replay(const Options& o,int total) : options(o),connections(total),finished(0),incomplete(0) {}
+
+    const Options& options;
+    const int connections;
+    std::atomic<int> finished;
+    std::atomic<int> incomplete;   //响应没收齐就被断开的连接
+    std::promise<void> done;
+};
+
+static bool loadStreams(const std::string& path,std::vector<Stream>* streams)
+{
+    CaptureReader reader(path);
+    if(!reader.valid())
+    {
+        return false;
+    }
+    std::map<uint64_t,Stream> open;
+    std::map<uint64_t,int64_t> openNs;
+    CaptureRecord record;
+    while(reader.next(&record))
+    {
+        Stream& stream = open[record.connId];
+        if(openNs.count(record.connId) == 0)
+        {
+            openNs[record.connId] = record.timeNs;
+        }
+        if(record.event == kCaptureIn)
+        {
+            Chunk chunk;
+            chunk.offsetNs = record.timeNs - openNs[record.connId];
+            chunk.data.swap(record.data);
+            chunk.expected = 0;
+            stream.chunks.push_back(std::move(chunk));
+        }
+        else if(record.event == kCaptureOut)
+        {
+            (stream.chunks.empty() ? stream.greeting : stream.chunks.back().expected) += record.data.size();
+        }
+        else if(record.event == kCaptureClose)
+        {
+            if(!stream.chunks.empty())
+            {
+                streams->push_back(std::move(stream));
+            }
+            open.erase(record.connId);
+            openNs.erase(record.connId);
+        }
+    }
+    for(auto& item : open) //抓包结束时还没关闭的连接
+    {
+        if(!item.second.chunks.empty())
+        {
+            streams->push_back(std::move(item.second));
+        }
+    }
+    return true;
+}
+
+class Player
+{
+public:
+    Player(EventLoop* loop,const InetAddress& addr,const Stream* stream,Replay* replay)
+        :loop_(loop)
+        ,client_(loop,addr,"Replay")
+        ,stream_(stream)
+        ,replay_(replay)
+        ,next_(0)
+        ,received_(0)
+        ,expected_(stream->greeting)
+        ,sent_(0)
+        ,startNs_(0)
+        ,timerActive_(false)
+        ,finished_(false)
+    {
+        client_.setConnectionCallback([this](const TcpConnectionPtr& conn) { onConnection(conn); });
+        client_.setMessageCallback([this](const TcpConnectionPtr&,Buffer* buf,Timestamp)
+        {
+            received_ += buf->readableBytes();
+            buf->retrieveAll();
+            drain();
+            sendDue();
+        });
+    }
+
+    ~Player()
+    {
+        if(timerActive_)
+        {
+            loop_->cancel(timer_);
+        }
+        if(conn_)
+        {
+            //连接会比Player活得久，回调不能再指向this
+            conn_->setConnectionCallback(ConnectionCallback());
+            conn_->setMessageCallback([](const TcpConnectionPtr&,Buffer* buf,Timestamp) { buf->retrieveAll(); });
+        }
+    }
+
+    void start() { client_.connect(); }
+
+    const std::vector<int64_t>& latencies() const { return latencies_; }
+    uint64_t sentBytes() const { return sent_; }
+    uint64_t receivedBytes() const { return received_; }
+
+private:
+    struct Pending
+    {
+        int64_t sendNs;
+        uint64_t expected; //收到这么多字节时这段数据的响应就齐了(累计值)
+        bool timed;        //这段数据有没有响应
+    };
+
+    void onConnection(const TcpConnectionPtr& conn)
+    {
+        if(conn->connected())
+        {
+            conn_ = conn;
+            startNs_ = bench::nowNs();
+            sendDue();
+        }
+        else
+        {
+            conn_.reset();
+            if(!finished_)
+            {
+                ++replay_->incomplete;
+                finish();
+            }
+        }
+    }
+
+    // 把已经到时间的数据都发出去，再为下一段定时
+    void sendDue()
+    {
+        const double speed = replay_->options.speed;
+        while(!finished_ && conn_)
+        {
+            if(next_ >= stream_->chunks.size())
+            {
+                if(pending_.empty())
+                {
+                    finish();
+                }
+                return;
+            }
+            const Chunk& chunk = stream_->chunks[next_];
+            if(speed <= 0)
+            {
+                if(!pending_.empty()) //闭环模式，等上一段的响应
+                {
+                    return;
+                }
+            }
+            else
+            {
+                int64_t delay = startNs_ + static_cast<int64_t>(chunk.offsetNs / speed) - bench::nowNs();
+                if(delay > 0)
+                {
+                    if(!timerActive_)
+                    {
+                        timerActive_ = true;
+                        timer_ = loop_->runAfter(delay / 1e9,[this]()
+                        {
+                            timerActive_ = false;
+                            sendDue();
+                        });
+                    }
+                    return;
+                }
+            }
+            expected_ += chunk.expected;
+            Pending pending;
+            pending.sendNs = bench::nowNs();
+            pending.expected = expected_;
+            pending.timed = chunk.expected > 0;
+            pending_.push_back(pending);
+            sent_ += chunk.data.size();
+            ++next_;
+            conn_->send(chunk.data);
+            drain();
+        }
+    }
+
+    void drain()
+    {
+        const int64_t now = bench::nowNs();
+        while(!pending_.empty() && received_ >= pending_.front().expected)
+        {
+            if(pending_.front().timed)
+            {
+                latencies_.push_back(now - pending_.front().sendNs);
+            }
+            pending_.pop_front();
+        }
+    }
+
+    void finish()
+    {
+        finished_ = true;
+        if(conn_)
+        {
+            conn_->shutdown();
+        }
+        if(++replay_->finished == replay_->connections)
+        {
+            replay_->done.set_value();
+        }
+    }
+
+    EventLoop* loop_;
+    TcpClient client_;
+    const Stream* stream_;
+    Replay* replay_;
+    TcpConnectionPtr conn_;
+    size_t next_;           //下一段要发的数据
+    uint64_t received_;
+    uint64_t expected_;     //已经发出的数据累计应该收到的响应字节数
+    uint64_t sent_;
+    int64_t startNs_;
+    TimerId timer_;
+    bool timerActive_;
+    bool finished_;
+    std::deque<Pending> pending_;
+    std::vector<int64_t> latencies_;
+};
+
+// 在loop线程里执行func并等它完成
+template <typename Func>
+static void runAndWait(EventLoop* loop,Func func)
+{
+    std::promise<void> done;
+    loop->runInLoop([&]() { func(); done.set_value(); });
+    done.get_future().wait();
+}
+
+static double percentileMs(const std::vector<int64_t>& sorted,double p)
+{
+    if(sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1,static_cast<size_t>(sorted.size() * p));
+    return sorted[index] / 1e6;
+}
+
+int main(int argc,char *argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr,"usage: %s capture_file [-h host] [-p port] [-c connections] [-s speed] [--threads N] [--timeout seconds]\n",argv[0]);
+        return 1;
+    }
+    Options options;
+    options.path = argv[1];
+    for(int i=2;i+1<argc;i+=2)
+    {
+        std::string flag = argv[i];
+        const char* value = argv[i + 1];
+        if(flag == "-h") options.host = value;
+        else if(flag == "-p") options.port = atoi(value);
+        else if(flag == "-c") options.connections = atoi(value);
+        else if(flag == "-s") options.speed = atof(value);
+        else if(flag == "--threads") options.threads = atoi(value);
+        else if(flag == "--timeout") options.timeout = atof(value);
+        else
+        {
+            fprintf(stderr,"unknown option %s\n",flag.c_str());
+            return 1;
+        }
+    }
+    options.threads = std::max(options.threads,1);
+
+    std::vector<Stream> streams;
+    if(!loadStreams(options.path,&streams) || streams.empty())
+    {
+        fprintf(stderr,"no replayable streams in %s\n",options.path.c_str());
+        return 1;
+    }
+    const int connections = options.connections > 0 ? options.connections : static_cast<int>(streams.size());
+    bench::SilenceLogger silence;
+
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<EventLoop*> loops;
+    for(int i=0;i<options.threads;i++)
+    {
+        threads.emplace_back(new EventLoopThread());
+        loops.push_back(threads.back()->startLoop());
+    }
+
+    Replay replay(options,connections);
+    InetAddress addr(static_cast<uint16_t>(options.port),options.host);
+    std::vector<std::unique_ptr<Player>> players(connections);
+    int64_t start = bench::nowNs();
+    for(int i=0;i<connections;i++)
+    {
+        EventLoop* loop = loops[i % loops.size()];
+        const Stream* stream = &streams[i % streams.size()];
+        runAndWait(loop,[&,i,loop,stream]()
+        {
+            players[i].reset(new Player(loop,addr,stream,&replay));
+            players[i]->start();
+        });
+    }
+    std::future<void> done = replay.done.get_future();
+    bool timedOut = done.wait_for(std::chrono::duration<double>(options.timeout)) != std::future_status::ready;
+    int64_t elapsed = bench::nowNs() - start;
+
+    std::vector<int64_t> all;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    for(int i=0;i<connections;i++)
+    {
+        runAndWait(loops[i % loops.size()],[&,i]()
+        {
+            all.insert(all.end(),players[i]->latencies().begin(),players[i]->latencies().end());
+            sent += players[i]->sentBytes();
+            received += players[i]->receivedBytes();
+            players[i].reset();
+        });
+    }
+    std::sort(all.begin(),all.end());
+    const int unfinished = timedOut ? connections - replay.finished.load() : 0;
+    printf("{\"bench\":\"replay\",\"streams\":%zu,\"connections\":%d,\"speed\":%.2f,\"requests\":%zu,"
+           "\"bytes_sent\":%llu,\"bytes_received\":%llu,\"incomplete\":%d,\"elapsed_s\":%.3f,\"requests_per_sec\":%.0f,"
+           "\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,\"max_ms\":%.3f}\n",
+           streams.size(),connections,options.speed,all.size(),
+           (unsigned long long)sent,(unsigned long long)received,replay.incomplete.load() + unfinished,
+           elapsed / 1e9,all.size() * 1e9 / elapsed,
+           percentileMs(all,0.5),percentileMs(all,0.9),percentileMs(all,0.99),percentileMs(all,0.999),
+           all.empty() ? 0.0 : all.back() / 1e6);
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "bench.h"
+
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/InetAddress.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+同一个回显负载分别跑在回环TCP和unix域socket上:
+    C个客户端连接(每个一个线程，阻塞IO)，每个连接做R次S字节的ping-pong
+ns_per_op是所有连接合计的每次往返耗时，ops_per_sec*S就是回显吞吐
+用法: ./transport_bench [连接数] [服务端线程数]
+*/
+
+static bool writeAll(int fd,const char *data,size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t n = ::write(fd,data,len);
+        if(n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd,char *data,size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t n = ::read(fd,data,len);
+        if(n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void runClients(const InetAddress &addr,int connections,size_t msgSize,int64_t roundTrips)
+{
+    std::vector<std::thread> threads;
+    for(int c=0;c<connections;c++)
+    {
+        threads.emplace_back([&]()
+        {
+            int fd = ::socket(addr.family(),SOCK_STREAM | SOCK_CLOEXEC,0);
+            if(::connect(fd,addr.getSockAddr(),addr.getSockLen()) < 0)
+            {
+                ::close(fd);
+                return;
+            }
+            std::string msg(msgSize,'x');
+            std::string reply(msgSize,'\0');
+            for(int64_t i=0;i<roundTrips;i++)
+            {
+                if(!writeAll(fd,msg.data(),msg.size()) || !readAll(fd,&reply[0],reply.size()))
+                {
+                    break;
+                }
+            }
+            ::close(fd);
+        });
+    }
+    for(std::thread &t : threads)
+    {
+        t.join();
+    }
+}
+
+static void benchTransport(const char *name,const InetAddress &addr,int connections,int serverThreads)
+{
+    EventLoop loop;
+    TcpServer server(&loop,addr,name);
+    server.setThreadNum(serverThreads);
+    server.setMessageCallback([](const TcpConnectionPtr &conn,Buffer *buf,Timestamp)
+    {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+
+    std::thread client([&]()
+    {
+        const size_t sizes[] = {64,4096,65536};
+        for(size_t size : sizes)
+        {
+            int64_t roundTrips = size >= 65536 ? 2000 : 20000;
+            bench::run(std::string("transport.pingpong.") + name,size,roundTrips * connections,
+                [&](int64_t iters)
+                {
+                    int64_t perConn = iters / connections;
+                    runClients(addr,connections,size,perConn);
+                    return perConn * connections;
+                });
+        }
+        loop.runInLoop([&loop]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+}
+
+int main(int argc,char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 4;
+    int serverThreads = argc > 2 ? atoi(argv[2]) : 2;
+    bench::SilenceLogger silence;
+
+    std::string path = "/tmp/mymuduo_transport_bench.sock";
+    benchTransport("tcp",InetAddress(19777,"127.0.0.1"),connections,serverThreads);
+    benchTransport("unix",InetAddress::fromUnixPath(path),connections,serverThreads);
+    ::unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/ComputePool.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <algorithm>
+#include <stdlib.h>
+
+/*
+把CPU密集的请求交给ComputePool的示例，监听8004端口，按行处理:
+    fib <n>    在计算线程里算第n个斐波那契数(故意用递归)，结果回到连接的loop里发送，
+               同一个连接上的多个请求按顺序回复，不同连接的请求在计算线程里并行
+    其它       在IO线程里直接原样返回
+IO线程只有一个，重请求在算的时候，同一个loop上的轻请求照样能马上得到回复
+*/
+class ComputeServer
+{
+public:
+    ComputeServer(EventLoop *loop,const InetAddress &addr)
+        :server_(loop,addr,"Compute")
+    {
+        server_.setMessageCallback(
+            std::bind(&ComputeServer::onMessage,this,std::placeholders::_1,std::placeholders::_2,std::placeholders::_3)
+        );
+    }
+
+    void start()
+    {
+        pool_.start(4);
+        server_.start();
+    }
+
+private:
+    static uint64_t fib(int n)
+    {
+        return n < 2 ? n : fib(n - 1) + fib(n - 2);
+    }
+
+    void onMessage(const TcpConnectionPtr &conn,Buffer *buf,Timestamp time)
+    {
+        for(;;)
+        {
+            const char *begin = buf->peek();
+            const char *end = begin + buf->readableBytes();
+            const char *eol = std::find(begin,end,'\n');
+            if(eol == end)
+            {
+                break;
+            }
+            std::string line(begin,eol);
+            buf->retrieve(eol - begin + 1);
+            if(line.compare(0,4,"fib ") == 0)
+            {
+                int n = atoi(line.c_str() + 4);
+                std::shared_ptr<uint64_t> result = std::make_shared<uint64_t>(0);
+                pool_.submitOrdered(conn,
+                    [n,result]() { *result = fib(n); },
+                    [n,result](const TcpConnectionPtr &c)
+                    {
+                        if(c->connected())
+                        {
+                            c->send("fib " + std::to_string(n) + " = " + std::to_string(*result) + "\n");
+                        }
+                    });
+            }
+            else
+            {
+                conn->send(line + "\n");
+            }
+        }
+    }
+
+    TcpServer server_;
+    ComputePool pool_;
+};
+
+int main()
+{
+    EventLoop loop;
+    InetAddress addr(8004);
+    ComputeServer server(&loop,addr);
+    server.start();
+    loop.loop();
+    return 0;
+}
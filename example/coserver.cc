@@ -0,0 +1,39 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Coroutine.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+
+// 基于协程的行回显服务: 每收到一行就原样发回，写完之后再读下一行
+co::Task echoSession(TcpConnectionPtr conn)
+{
+    LOG_INFO("coroutine session UP : %s",conn->peerAddress().toIpPort().c_str());
+    for(;;)
+    {
+        std::string line = co_await co::readUntil(conn,"\n");
+        if(line.empty()) //连接已经断开
+        {
+            break;
+        }
+        conn->send(line);
+        if(!co_await co::writeComplete(conn))
+        {
+            break;
+        }
+    }
+    LOG_INFO("coroutine session DOWN : %s",conn->peerAddress().toIpPort().c_str());
+}
+
+int main()
+{
+    EventLoop loop;
+    InetAddress addr(8001);
+    TcpServer server(&loop,addr,"CoEchoServer-01");
+    server.setThreadNum(3);
+    co::serve(server,echoSession);
+    server.start();
+
+    loop.loop();
+
+    return 0;
+}
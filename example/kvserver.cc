@@ -0,0 +1,383 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/RespCodec.h>
+#include <mymuduo/TrafficCapture.h>
+#include <mymuduo/Logger.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdlib.h>
+#include <errno.h>
+
+/*
+RESP协议的内存KV示例，监听6380端口，可以直接用redis-cli、redis-benchmark访问:
+    ./kvserver [IO线程数] [抓包文件]
+给了抓包文件时把所有连接的流量记下来，可以用bench/traffic_replay重放
+支持 PING ECHO GET SET SETNX DEL EXISTS INCR DECR INCRBY APPEND STRLEN，以及客户端握手用的COMMAND/CONFIG
+
+键空间按key的哈希分片，每个IO线程(EventLoop)一个分片，分片只在自己的loop线程里访问，不加锁
+key落在本连接所在loop的分片上时直接执行，否则一次onMessage里发往同一个分片的命令打包成一个任务投递过去，
+执行完再把这一批回复投递回连接的loop；同一个连接上流水线的命令可能在不同分片上执行，回复按序号排好再发送
+多key的DEL/EXISTS只支持一个key
+*/
+
+namespace
+{
+
+struct Shard
+{
+    EventLoop* loop;
+    std::unordered_map<std::string,std::string> data;
+};
+
+// 连接的状态，只在连接的loop线程里访问
+struct Session
+{
+    Session() : nextSeq(0),nextReply(0) {}
+
+    uint64_t nextSeq;       //下一条命令的序号
+    uint64_t nextReply;     //下一条该发送的回复的序号
+    std::map<uint64_t,std::string> ready; //先执行完、排在前面的回复还没好的
+};
+
+// 发往别的分片的一批命令
+struct Batch
+{
+    TcpConnectionPtr conn;
+    std::vector<uint64_t> seqs;
+    std::vector<std::vector<std::string>> commands;
+    std::vector<std::string> replies;
+};
+using BatchPtr = std::shared_ptr<Batch>;
+
+uint64_t hashKey(const char* data,size_t len)
+{
+    uint64_t h = 14695981039346656037ULL; //FNV-1a
+    for(size_t i=0;i<len;i++)
+    {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+bool parseInt64(const std::string& str,int64_t* value)
+{
+    if(str.empty() || str.size() > 20)
+    {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    long long v = ::strtoll(str.c_str(),&end,10);
+    if(errno != 0 || end != str.c_str() + str.size())
+    {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+} // namespace
+
+class KvServer
+{
+public:
+    KvServer(EventLoop *loop,const InetAddress &addr,int threads)
+        :server_(loop,addr,"KvServer")
+    {
+        server_.setConnectionCallback(
+            std::bind(&KvServer::onConnection,this,std::placeholders::_1)
+        );
+        server_.setMessageCallback(
+            std::bind(&KvServer::onMessage,this,std::placeholders::_1,std::placeholders::_2,std::placeholders::_3)
+        );
+        server_.setThreadInitCallback(std::bind(&KvServer::onThreadInit,this,std::placeholders::_1));
+        server_.setCorkedWrites(true);
+        server_.setThreadNum(threads);
+    }
+
+    void setTrafficCapture(const TrafficCapturePtr& capture) { server_.setTrafficCapture(capture); }
+
+    // start()返回时所有loop线程都已经执行过onThreadInit，之后shards_只读
+    void start()
+    {
+        server_.start();
+        LOG_INFO("KvServer started with %zu shards \n",shards_.size());
+    }
+
+private:
+    void onThreadInit(EventLoop* loop)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shardIndex_[loop] = shards_.size();
+        shards_.emplace_back(new Shard());
+        shards_.back()->loop = loop;
+    }
+
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            conn->setContext(std::make_shared<Session>());
+        }
+    }
+
+    // 有key的命令返回key所在的分片，没有key的返回-1，就地执行
+    int route(const std::vector<RespSlice>& args) const
+    {
+        if(args.size() < 2 || args[0].equalsIgnoreCase("ping") || args[0].equalsIgnoreCase("echo")
+            || args[0].equalsIgnoreCase("command") || args[0].equalsIgnoreCase("config"))
+        {
+            return -1;
+        }
+        return static_cast<int>(hashKey(args[1].data,args[1].len) % shards_.size());
+    }
+
+    void onMessage(const TcpConnectionPtr &conn,Buffer *buf,Timestamp time)
+    {
+        Session* session = static_cast<Session*>(conn->getContext().get());
+        const int local = static_cast<int>(shardIndex_.at(conn->getLoop()));
+        std::vector<BatchPtr> batches(shards_.size());
+        std::vector<RespSlice> args;
+        Buffer out;
+        size_t consumed = 0;
+        int ret;
+        while((ret = RespCodec::parseCommand(buf,&args,&consumed)) > 0)
+        {
+            if(args.empty())
+            {
+                buf->retrieve(consumed);
+                continue;
+            }
+            const uint64_t seq = session->nextSeq++;
+            const int shard = route(args);
+            if(shard < 0 || shard == local)
+            {
+                Shard* target = shards_[local].get();
+                if(seq == session->nextReply && session->ready.empty())
+                {
+                    execute(target,args,&out); //前面的回复都发了，直接排进out
+                    ++session->nextReply;
+                }
+                else
+                {
+                    Buffer reply;
+                    execute(target,args,&reply);
+                    session->ready[seq] = reply.retrieveAllAsString();
+                }
+            }
+            else
+            {
+                BatchPtr& batch = batches[shard];
+                if(!batch)
+                {
+                    batch = std::make_shared<Batch>();
+                    batch->conn = conn;
+                }
+                batch->seqs.push_back(seq);
+                batch->commands.emplace_back();
+                for(const RespSlice& arg : args)
+                {
+                    batch->commands.back().push_back(arg.toString()); //跨线程，拷贝出Buffer
+                }
+            }
+            buf->retrieve(consumed);
+        }
+        if(ret < 0)
+        {
+            RespCodec::appendError(&out,"ERR Protocol error");
+        }
+        flushReady(session,&out);
+        if(out.readableBytes() > 0)
+        {
+            conn->send(out.peek(),out.readableBytes());
+        }
+        if(ret < 0)
+        {
+            buf->retrieveAll();
+            conn->shutdown();
+        }
+        for(size_t i=0;i<batches.size();i++)
+        {
+            if(batches[i])
+            {
+                Shard* shard = shards_[i].get();
+                shard->loop->queueInLoop(std::bind(&KvServer::executeBatch,this,shard,batches[i]));
+            }
+        }
+    }
+
+    // 在分片的loop线程里执行一批命令，回复投递回连接的loop
+    void executeBatch(Shard* shard,const BatchPtr& batch)
+    {
+        std::vector<RespSlice> args;
+        Buffer reply;
+        batch->replies.reserve(batch->commands.size());
+        for(const std::vector<std::string>& command : batch->commands)
+        {
+            args.clear();
+            for(const std::string& arg : command)
+            {
+                args.push_back(RespSlice(arg.data(),arg.size()));
+            }
+            execute(shard,args,&reply);
+            batch->replies.push_back(reply.retrieveAllAsString());
+        }
+        batch->conn->getLoop()->queueInLoop(std::bind(&KvServer::deliverBatch,batch));
+    }
+
+    static void deliverBatch(const BatchPtr& batch)
+    {
+        const TcpConnectionPtr& conn = batch->conn;
+        if(!conn->connected())
+        {
+            return;
+        }
+        Session* session = static_cast<Session*>(conn->getContext().get());
+        for(size_t i=0;i<batch->seqs.size();i++)
+        {
+            session->ready[batch->seqs[i]].swap(batch->replies[i]);
+        }
+        Buffer out;
+        flushReady(session,&out);
+        if(out.readableBytes() > 0)
+        {
+            conn->send(out.peek(),out.readableBytes());
+        }
+    }
+
+    // 把序号连续的回复按顺序挪进out
+    static void flushReady(Session* session,Buffer* out)
+    {
+        auto it = session->ready.begin();
+        while(it != session->ready.end() && it->first == session->nextReply)
+        {
+            out->append(it->second.data(),it->second.size());
+            ++session->nextReply;
+            it = session->ready.erase(it);
+        }
+    }
+
+    static void execute(Shard* shard,const std::vector<RespSlice>& args,Buffer* out)
+    {
+        const RespSlice& cmd = args[0];
+        const size_t argc = args.size();
+        if(cmd.equalsIgnoreCase("ping"))
+        {
+            if(argc > 1)
+            {
+                RespCodec::appendBulkString(out,args[1].data,args[1].len);
+            }
+            else
+            {
+                RespCodec::appendSimpleString(out,"PONG");
+            }
+        }
+        else if(cmd.equalsIgnoreCase("echo") && argc == 2)
+        {
+            RespCodec::appendBulkString(out,args[1].data,args[1].len);
+        }
+        else if(cmd.equalsIgnoreCase("command") || cmd.equalsIgnoreCase("config"))
+        {
+            RespCodec::appendArrayHeader(out,0);
+        }
+        else if(cmd.equalsIgnoreCase("get") && argc == 2)
+        {
+            auto it = shard->data.find(args[1].toString());
+            if(it == shard->data.end())
+            {
+                RespCodec::appendNullBulkString(out);
+            }
+            else
+            {
+                RespCodec::appendBulkString(out,it->second);
+            }
+        }
+        else if(cmd.equalsIgnoreCase("set") && argc == 3)
+        {
+            shard->data[args[1].toString()].assign(args[2].data,args[2].len);
+            RespCodec::appendSimpleString(out,"OK");
+        }
+        else if(cmd.equalsIgnoreCase("setnx") && argc == 3)
+        {
+            bool inserted = shard->data.insert(std::make_pair(args[1].toString(),args[2].toString())).second;
+            RespCodec::appendInteger(out,inserted ? 1 : 0);
+        }
+        else if(cmd.equalsIgnoreCase("del") && argc == 2)
+        {
+            RespCodec::appendInteger(out,static_cast<int64_t>(shard->data.erase(args[1].toString())));
+        }
+        else if(cmd.equalsIgnoreCase("exists") && argc == 2)
+        {
+            RespCodec::appendInteger(out,static_cast<int64_t>(shard->data.count(args[1].toString())));
+        }
+        else if((cmd.equalsIgnoreCase("incr") || cmd.equalsIgnoreCase("decr")) && argc == 2)
+        {
+            incrBy(shard,args[1],cmd.equalsIgnoreCase("incr") ? 1 : -1,out);
+        }
+        else if(cmd.equalsIgnoreCase("incrby") && argc == 3)
+        {
+            int64_t delta;
+            if(!parseInt64(args[2].toString(),&delta))
+            {
+                RespCodec::appendError(out,"ERR value is not an integer or out of range");
+                return;
+            }
+            incrBy(shard,args[1],delta,out);
+        }
+        else if(cmd.equalsIgnoreCase("append") && argc == 3)
+        {
+            std::string& value = shard->data[args[1].toString()];
+            value.append(args[2].data,args[2].len);
+            RespCodec::appendInteger(out,static_cast<int64_t>(value.size()));
+        }
+        else if(cmd.equalsIgnoreCase("strlen") && argc == 2)
+        {
+            auto it = shard->data.find(args[1].toString());
+            RespCodec::appendInteger(out,it == shard->data.end() ? 0 : static_cast<int64_t>(it->second.size()));
+        }
+        else
+        {
+            std::string message = "ERR unknown command or wrong number of arguments for '" + cmd.toString() + "'";
+            RespCodec::appendError(out,message.c_str());
+        }
+    }
+
+    static void incrBy(Shard* shard,const RespSlice& key,int64_t delta,Buffer* out)
+    {
+        std::string& value = shard->data[key.toString()];
+        int64_t current = 0;
+        if(!value.empty() && !parseInt64(value,&current))
+        {
+            RespCodec::appendError(out,"ERR value is not an integer or out of range");
+            return;
+        }
+        current += delta;
+        value = std::to_string(current);
+        RespCodec::appendInteger(out,current);
+    }
+
+    TcpServer server_;
+    std::mutex mutex_; //只在start()期间保护下面两个成员
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::map<EventLoop*,size_t> shardIndex_;
+};
+
+int main(int argc,char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    EventLoop loop;
+    InetAddress addr(6380);
+    KvServer server(&loop,addr,threads);
+    if(argc > 2)
+    {
+        server.setTrafficCapture(TrafficCapture::open(argv[2]));
+    }
+    server.start();
+    loop.loop();
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/Relay.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <memory>
+#include <stdlib.h>
+
+/*
+L4转发示例: 监听8002端口，每个入站连接都向上游建立一条出站连接，两条连接之间用Relay通过splice转发
+用法: ./proxy <上游ip> <上游端口>
+*/
+
+// 挂在入站连接context上，入站连接销毁时一起释放
+struct Tunnel
+{
+    std::unique_ptr<TcpClient> client;
+    RelayPtr relay;
+};
+
+class ProxyServer
+{
+public:
+    ProxyServer(EventLoop *loop,
+            const InetAddress &addr,
+            const InetAddress &upstreamAddr)
+        :server_(loop,addr,"Proxy")
+        ,upstreamAddr_(upstreamAddr)
+    {
+        server_.setConnectionCallback(
+            std::bind(&ProxyServer::onConnection,this,std::placeholders::_1)
+        );
+        //上游连上之前到达的数据留在inputBuffer里，Relay启动时一起转发
+        //同时暂停读取，剩下的数据(包括半关闭的FIN)留在内核里交给Relay
+        server_.setMessageCallback([](const TcpConnectionPtr &conn,Buffer*,Timestamp)
+        {
+            conn->stopRead();
+        });
+        server_.setThreadNum(3);
+    }
+
+    void start()
+    {
+        server_.start();
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            std::shared_ptr<Tunnel> tunnel = std::make_shared<Tunnel>();
+            tunnel->client.reset(new TcpClient(conn->getLoop(),upstreamAddr_,"Upstream"));
+            std::weak_ptr<TcpConnection> weakConn(conn);
+            std::weak_ptr<Tunnel> weakTunnel(tunnel);
+            tunnel->client->setConnectionCallback([weakConn,weakTunnel](const TcpConnectionPtr &upstream)
+            {
+                TcpConnectionPtr downstream = weakConn.lock();
+                std::shared_ptr<Tunnel> tunnel = weakTunnel.lock();
+                if(upstream->connected() && downstream && tunnel)
+                {
+                    tunnel->relay = std::make_shared<Relay>(downstream,upstream);
+                    tunnel->relay->start();
+                }
+                else if(!upstream->connected())
+                {
+                    if(tunnel && tunnel->relay)
+                    {
+                        tunnel->relay->close();
+                    }
+                    else if(downstream)
+                    {
+                        downstream->forceClose();
+                    }
+                }
+            });
+            conn->setContext(tunnel);
+            tunnel->client->connect();
+        }
+        else
+        {
+            Tunnel *tunnel = static_cast<Tunnel*>(conn->getContext().get());
+            if(tunnel && tunnel->relay)
+            {
+                tunnel->relay->close();
+            }
+            else if(tunnel)
+            {
+                tunnel->client->stop();
+            }
+        }
+    }
+
+    TcpServer server_;
+    InetAddress upstreamAddr_;
+};
+
+int main(int argc,char *argv[])
+{
+    if(argc < 3)
+    {
+        printf("usage: %s <upstream ip> <upstream port>\n",argv[0]);
+        return 1;
+    }
+    EventLoop loop;
+    InetAddress addr(8002);
+    InetAddress upstreamAddr(static_cast<uint16_t>(atoi(argv[2])),argv[1]);
+    ProxyServer server(&loop,addr,upstreamAddr);
+    server.start();
+    loop.loop();
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Broadcaster.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <algorithm>
+
+/*
+按行的pub/sub示例，监听8003端口:
+    sub <topic> [drop|conflate]   订阅，默认排队，慢消费者可以选择丢弃或者只保留最新一条
+    unsub <topic>
+    pub <topic> <message>         发给所有订阅者，订阅者收到 "<topic> <message>\n"
+*/
+class PubSubServer
+{
+public:
+    PubSubServer(EventLoop *loop,const InetAddress &addr)
+        :server_(loop,addr,"PubSub")
+        ,broadcaster_(64 * 1024)
+    {
+        server_.setConnectionCallback(
+            std::bind(&PubSubServer::onConnection,this,std::placeholders::_1)
+        );
+        server_.setMessageCallback(
+            std::bind(&PubSubServer::onMessage,this,std::placeholders::_1,std::placeholders::_2,std::placeholders::_3)
+        );
+        server_.setThreadNum(3);
+    }
+
+    void start()
+    {
+        server_.start();
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if(!conn->connected())
+        {
+            broadcaster_.unsubscribeAll(conn);
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr &conn,Buffer *buf,Timestamp time)
+    {
+        for(;;)
+        {
+            const char *begin = buf->peek();
+            const char *end = begin + buf->readableBytes();
+            const char *eol = std::find(begin,end,'\n');
+            if(eol == end)
+            {
+                break;
+            }
+            std::string line(begin,eol);
+            buf->retrieve(eol - begin + 1);
+            if(!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            handleCommand(conn,line);
+        }
+    }
+
+    void handleCommand(const TcpConnectionPtr &conn,const std::string &line)
+    {
+        size_t sp = line.find(' ');
+        std::string cmd = line.substr(0,sp);
+        std::string rest = sp == std::string::npos ? std::string() : line.substr(sp + 1);
+        if(cmd == "sub")
+        {
+            size_t sp2 = rest.find(' ');
+            std::string topic = rest.substr(0,sp2);
+            std::string policy = sp2 == std::string::npos ? std::string() : rest.substr(sp2 + 1);
+            broadcaster_.subscribe(topic,conn,
+                policy == "drop" ? kSlowConsumerDrop :
+                policy == "conflate" ? kSlowConsumerConflate : kSlowConsumerQueue);
+        }
+        else if(cmd == "unsub")
+        {
+            broadcaster_.unsubscribe(rest,conn);
+        }
+        else if(cmd == "pub")
+        {
+            size_t sp2 = rest.find(' ');
+            std::string topic = rest.substr(0,sp2);
+            //拼好一次，所有订阅者共享这一份数据
+            broadcaster_.publish(topic,topic + " " + (sp2 == std::string::npos ? std::string() : rest.substr(sp2 + 1)) + "\n");
+        }
+    }
+
+    TcpServer server_;
+    Broadcaster broadcaster_;
+};
+
+int main()
+{
+    EventLoop loop;
+    InetAddress addr(8003);
+    PubSubServer server(&loop,addr);
+    server.start();
+    loop.loop();
+    return 0;
+}